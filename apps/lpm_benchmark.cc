@@ -0,0 +1,160 @@
+#include "dir_24_8.hh"
+#include "prefix_trie.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Longest-prefix-match lookups against a synthetic full routing table: build time, lookup rate,
+// and a check against a linear scan (how Router used to match) on a sample of the addresses.
+
+namespace {
+
+struct Options
+{
+  size_t prefixes = 800000;
+  size_t lookups = 10000000;
+};
+
+struct Route
+{
+  uint32_t prefix;
+  uint8_t length;
+};
+
+// Prefix lengths weighted roughly like a global IPv4 BGP table: mostly /24s, then /22s and /23s
+vector<Route> synthetic_table( size_t count, mt19937& rng )
+{
+  constexpr array<double, 33> weights { 0,   0,   0,   0,   0,   0,   0,   0,   0.1, 0.1,  0.1,
+                                        0.1, 0.2, 0.3, 0.4, 0.5, 1.5, 1.0, 1.5, 3.0, 4.0,  4.5,
+                                        11,  8,   58,  0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.05, 0.05 };
+  discrete_distribution<int> length_distribution( weights.begin(), weights.end() );
+  uniform_int_distribution<uint32_t> address_distribution;
+
+  vector<Route> table;
+  table.reserve( count );
+  unordered_set<uint64_t> seen;
+  while ( table.size() < count ) {
+    const auto length = static_cast<uint8_t>( length_distribution( rng ) );
+    const uint32_t prefix = address_distribution( rng ) & PrefixTrie::mask( length );
+    if ( seen.insert( uint64_t { prefix } << 8 | length ).second ) {
+      table.push_back( { prefix, length } );
+    }
+  }
+  return table;
+}
+
+// Half the addresses fall inside a route (so lookups go deep), half are uniformly random
+vector<uint32_t> lookup_addresses( const vector<Route>& table, size_t count, mt19937& rng )
+{
+  uniform_int_distribution<uint32_t> address_distribution;
+  uniform_int_distribution<size_t> route_distribution( 0, table.size() - 1 );
+  vector<uint32_t> addresses( count );
+  for ( size_t i = 0; i < count; i++ ) {
+    const uint32_t random = address_distribution( rng );
+    if ( i % 2 == 0 ) {
+      addresses[i] = random;
+    } else {
+      const Route& route = table[route_distribution( rng )];
+      addresses[i] = route.prefix | ( random & ~PrefixTrie::mask( route.length ) );
+    }
+  }
+  return addresses;
+}
+
+// The longest matching route, found by looking at every route
+optional<uint32_t> linear_match( const vector<Route>& table, uint32_t address )
+{
+  optional<uint32_t> best {};
+  for ( uint32_t i = 0; i < table.size(); i++ ) {
+    const uint32_t mask = PrefixTrie::mask( table[i].length );
+    if ( ( address & mask ) == table[i].prefix and ( not best or table[*best].length < table[i].length ) ) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+template<typename Table>
+void run( const string& name, Table& lpm, const vector<Route>& table, const vector<uint32_t>& addresses )
+{
+  const auto build_start = steady_clock::now();
+  for ( uint32_t i = 0; i < table.size(); i++ ) {
+    lpm.insert( table[i].prefix, table[i].length, i );
+  }
+  const duration<double> build_time = steady_clock::now() - build_start;
+
+  uint64_t matched = 0;
+  const auto lookup_start = steady_clock::now();
+  for ( const uint32_t address : addresses ) {
+    matched += lpm.lookup( address ).has_value();
+  }
+  const duration<double> lookup_time = steady_clock::now() - lookup_start;
+
+  // A linear scan per address is slow, so only check a sample
+  for ( size_t i = 0; i < min<size_t>( addresses.size(), 200 ); i++ ) {
+    if ( lpm.lookup( addresses[i] ) != linear_match( table, addresses[i] ) ) {
+      throw runtime_error( name + ": wrong match for address " + to_string( addresses[i] ) );
+    }
+  }
+
+  cout << fixed << setprecision( 1 ) << setw( 12 ) << name << ": built in " << build_time.count() * 1000
+       << " ms, " << lookup_time.count() * 1e9 / static_cast<double>( addresses.size() ) << " ns/lookup ("
+       << static_cast<double>( addresses.size() ) / lookup_time.count() / 1e6 << " M lookups/s, " << matched
+       << " matched)\n";
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+    auto args = span( argv, argc );
+
+    Options options;
+    if ( argc == 3 ) {
+      options.prefixes = stoul( args[1] );
+      options.lookups = stoul( args[2] );
+    } else if ( argc != 1 ) {
+      cerr << "Usage: " << args.front() << " [PREFIXES LOOKUPS]\n";
+      return EXIT_FAILURE;
+    }
+
+    mt19937 rng { 12345 }; // NOLINT(*-msc51-*): the same table every run
+    const auto table = synthetic_table( options.prefixes, rng );
+    const auto addresses = lookup_addresses( table, options.lookups, rng );
+    cout << table.size() << " prefixes, " << addresses.size() << " lookups\n";
+
+    PrefixTrie trie;
+    run( "patricia", trie, table, addresses );
+    cout << setw( 12 ) << "" << "  " << trie.node_count() << " nodes, " << trie.memory_usage() / ( 1 << 20 )
+         << " MiB\n";
+
+    Dir24_8 direct;
+    run( "dir-24-8", direct, table, addresses );
+    cout << setw( 12 ) << "" << "  " << direct.group_count() << " second-level groups, "
+         << direct.memory_usage() / ( 1 << 20 ) << " MiB\n";
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
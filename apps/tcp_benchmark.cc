@@ -0,0 +1,220 @@
+#include "minnow_tcp_socket.hh"
+#include "socket.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using namespace std::chrono;
+
+// Compare minnow's TCP (over an in-process link) with the kernel's (over loopback): round-trip
+// latency of small messages to an echo server, and bulk throughput to a discard server.
+
+namespace {
+
+constexpr uint16_t ECHO_PORT = 7;
+constexpr uint16_t DISCARD_PORT = 9;
+constexpr uint32_t CLIENT_ADDRESS = 0x0a000001; // 10.0.0.1
+constexpr size_t MESSAGE_SIZE = 64;
+constexpr size_t WRITE_SIZE = 65536;
+
+struct Options
+{
+  size_t round_trips = 2000;
+  size_t bulk_bytes = 16 << 20;
+};
+
+void shutdown_and_drain( TCPSocket& sock )
+{
+  sock.shutdown( SHUT_WR );
+  string buf;
+  do {
+    sock.read( buf );
+  } while ( not buf.empty() );
+  sock.close();
+}
+
+// MinnowTCPSocket::close() already waits for the peer to finish
+void shutdown_and_drain( MinnowTCPSocket& sock )
+{
+  sock.close();
+}
+
+template<typename SocketT>
+double mean_round_trip_us( SocketT& sock, size_t round_trips )
+{
+  const string message( MESSAGE_SIZE, 'x' );
+  string reply, buf;
+  const auto start = steady_clock::now();
+  for ( size_t i = 0; i < round_trips; i++ ) {
+    sock.write( message );
+    reply.clear();
+    while ( reply.size() < message.size() ) {
+      sock.read( buf );
+      if ( buf.empty() ) {
+        throw runtime_error( "echo server closed early" );
+      }
+      reply += buf;
+    }
+  }
+  const auto elapsed = duration_cast<duration<double, micro>>( steady_clock::now() - start );
+  shutdown_and_drain( sock );
+  return elapsed.count() / static_cast<double>( round_trips );
+}
+
+template<typename SocketT>
+double throughput_gbps( SocketT& sock, size_t bytes )
+{
+  const string chunk( WRITE_SIZE, 'y' );
+  const auto start = steady_clock::now();
+  for ( size_t sent = 0; sent < bytes; sent += chunk.size() ) {
+    sock.write( chunk );
+  }
+  shutdown_and_drain( sock ); // done once the discard server has seen everything and closed
+  const auto elapsed = duration_cast<duration<double>>( steady_clock::now() - start );
+  return static_cast<double>( bytes ) * 8 / elapsed.count() / 1e9;
+}
+
+void report( string_view stack, double rtt_us, double gbps )
+{
+  cout << setw( 8 ) << stack << ": round trip " << fixed << setprecision( 2 ) << setw( 9 ) << rtt_us
+       << " us, throughput " << setw( 6 ) << gbps << " Gbit/s\n";
+}
+
+// Kernel: an echo and a discard server on loopback, in a thread
+void run_kernel( const Options& options )
+{
+  TCPSocket echo_listener, discard_listener;
+  for ( auto* listener : { &echo_listener, &discard_listener } ) {
+    listener->set_reuseaddr();
+    listener->bind( Address { "127.0.0.1", 0 } );
+    listener->listen();
+  }
+
+  thread server { [&] {
+    string buf;
+    TCPSocket echo = echo_listener.accept();
+    for ( echo.read( buf ); not buf.empty(); echo.read( buf ) ) {
+      echo.write( buf );
+    }
+    echo.close();
+    TCPSocket discard = discard_listener.accept();
+    for ( discard.read( buf ); not buf.empty(); discard.read( buf ) ) {}
+    discard.close();
+  } };
+
+  TCPSocket echo_client;
+  echo_client.connect( echo_listener.local_address() );
+  const double rtt = mean_round_trip_us( echo_client, options.round_trips );
+  TCPSocket discard_client;
+  discard_client.connect( discard_listener.local_address() );
+  const double gbps = throughput_gbps( discard_client, options.bulk_bytes );
+  server.join();
+  report( "kernel", rtt, gbps );
+}
+
+// Echo and discard servers on a minnow stack
+class MinnowServers
+{
+public:
+  MinnowServers( FileDescriptor&& device, EventLoop& loop, const TCPConfig& config ) : driver_( move( device ), loop )
+  {
+    driver_.demux().listen( ECHO_PORT, config );
+    driver_.demux().listen( DISCARD_PORT, config );
+    driver_.set_activity_callback( [this] { serve(); } );
+  }
+
+private:
+  TCPStackDriver driver_;
+  unordered_map<TCPDemultiplexer::ConnectionId, bool> connections_ {}; // id -> echo?
+
+  void serve()
+  {
+    TCPDemultiplexer& demux = driver_.demux();
+    for ( const uint16_t port : { ECHO_PORT, DISCARD_PORT } ) {
+      while ( auto id = demux.accept( port ) ) {
+        connections_[id.value()] = port == ECHO_PORT;
+      }
+    }
+    erase_if( connections_, [&]( const auto& c ) { return not demux.has_connection( c.first ); } );
+    for ( const auto& [id, echo] : connections_ ) {
+      TCPPeer& peer = demux.peer( id );
+      Reader& in = peer.inbound_reader();
+      Writer& out = peer.outbound_writer();
+      while ( in.bytes_buffered() ) {
+        string_view data = in.peek();
+        if ( echo ) {
+          data = data.substr( 0, out.available_capacity() );
+          if ( data.empty() ) {
+            break;
+          }
+          out.push( string( data ) );
+        }
+        in.pop( data.size() );
+      }
+      if ( in.is_finished() and not out.is_closed() ) {
+        out.close();
+      }
+      demux.push( id );
+    }
+  }
+};
+
+// Minnow: each client socket gets an in-process link to a server stack that shares its event loop
+void run_minnow( const Options& options, const TCPConfig& config )
+{
+  const Address echo_address { "10.0.0.2", ECHO_PORT };
+  const Address discard_address { "10.0.0.2", DISCARD_PORT };
+
+  auto [echo_end, echo_server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket echo_client { move( echo_end ), CLIENT_ADDRESS, config };
+  const MinnowServers echo_servers { move( echo_server_end ), echo_client.event_loop(), config };
+  echo_client.connect( echo_address );
+  const double rtt = mean_round_trip_us( echo_client, options.round_trips );
+
+  auto [discard_end, discard_server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket discard_client { move( discard_end ), CLIENT_ADDRESS, config };
+  const MinnowServers discard_servers { move( discard_server_end ), discard_client.event_loop(), config };
+  discard_client.connect( discard_address );
+  const double gbps = throughput_gbps( discard_client, options.bulk_bytes );
+  report( "minnow", rtt, gbps );
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+    auto args = span( argv, argc );
+
+    Options options;
+    if ( argc == 3 ) {
+      options.round_trips = stoul( args[1] );
+      options.bulk_bytes = stoul( args[2] );
+    } else if ( argc != 1 ) {
+      cerr << "Usage: " << args.front() << " [ROUND_TRIPS BULK_BYTES]\n";
+      return EXIT_FAILURE;
+    }
+
+    TCPConfig config;
+    config.send_capacity = config.recv_capacity = 1 << 20;
+    config.window_scale = TCPConfig::window_scale_for( config.recv_capacity );
+
+    run_kernel( options );
+    run_minnow( options, config );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
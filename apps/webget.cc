@@ -1,4 +1,6 @@
+#include "minnow_tcp_socket.hh"
 #include "socket.hh"
+#include "tun.hh"
 
 #include <cstdlib>
 #include <iostream>
@@ -7,11 +9,10 @@
 
 using namespace std;
 
-void get_URL( const string& host, const string& path )
+// Works with either the kernel's TCPSocket or minnow's own MinnowTCPSocket
+template<typename SocketT>
+void fetch( SocketT& sock, const Address& addr, const string& host, const string& path )
 {
-  //  std::cout << "host: " << host << ", path" << path << std::endl;
-  const Address addr( host, "http" );
-  TCPSocket sock;
   string write_buff, read_buff;
   sock.connect( addr );
   write_buff = "GET " + path + " HTTP/1.1\r\n" + "Host: " + host + "\r\n" + "Connection: close\r\n\r\n\r\n";
@@ -26,6 +27,22 @@ void get_URL( const string& host, const string& path )
   sock.close();
 }
 
+void get_URL( const string& host, const string& path )
+{
+  //  std::cout << "host: " << host << ", path" << path << std::endl;
+  const Address addr( host, "http" );
+  TCPSocket sock;
+  fetch( sock, addr, host, path );
+}
+
+// The same, but through minnow's TCP over a TUN device (set up with `ip tuntap add mode tun ...`)
+void get_URL_minnow( const string& tun_device, const string& local_address, const string& host, const string& path )
+{
+  const Address addr( host, "http" );
+  MinnowTCPSocket sock { TunFD { tun_device }, Address { local_address }.ipv4_numeric() };
+  fetch( sock, addr, host, path );
+}
+
 int main( int argc, char* argv[] )
 {
   try {
@@ -37,19 +54,25 @@ int main( int argc, char* argv[] )
 
     // The program takes two command-line arguments: the hostname and "path" part of the URL.
     // Print the usage message unless there are these two arguments (plus the program name
-    // itself, so arg count = 3 in total).
-    if ( argc != 3 ) {
-      cerr << "Usage: " << args.front() << " HOST PATH\n";
+    // itself, so arg count = 3 in total), optionally preceded by "--tun DEVICE LOCAL_ADDRESS".
+    const bool use_tun = argc == 6 and string( args[1] ) == "--tun";
+    if ( argc != 3 and not use_tun ) {
+      cerr << "Usage: " << args.front() << " [--tun DEVICE LOCAL_ADDRESS] HOST PATH\n";
       cerr << "\tExample: " << args.front() << " stanford.edu /class/cs144\n";
+      cerr << "\tExample: " << args.front() << " --tun tun144 169.254.144.9 stanford.edu /class/cs144\n";
       return EXIT_FAILURE;
     }
 
     // Get the command-line arguments.
-    const string host { args[1] };
-    const string path { args[2] };
+    const string host { args[argc - 2] };
+    const string path { args[argc - 1] };
 
     // Call the student-written function.
-    get_URL( host, path );
+    if ( use_tun ) {
+      get_URL_minnow( args[2], args[3], host, path );
+    } else {
+      get_URL( host, path );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return EXIT_FAILURE;
@@ -6,3 +6,13 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call")
+
+# compile-time log level (see util/log.hh): Trace, Debug, Info, Warn, Error or Off
+if (NOT MINNOW_LOG_LEVEL)
+  if (CMAKE_BUILD_TYPE STREQUAL "Debug")
+    set (MINNOW_LOG_LEVEL "Trace")
+  else ()
+    set (MINNOW_LOG_LEVEL "Warn")
+  endif ()
+endif ()
+add_compile_definitions (MINNOW_LOG_LEVEL=${MINNOW_LOG_LEVEL})
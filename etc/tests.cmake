@@ -41,6 +41,21 @@ ttest(wrapping_integers_extra)
 ttest(recv_connect)
 ttest(recv_transmit)
 ttest(recv_window)
+ttest(recv_window_scale)
+ttest(recv_delayed_ack)
+ttest(recv_autotune)
+ttest(recv_sws)
+ttest(segment_coalescer)
+ttest(tcp_segment)
+ttest(tcp_peer)
+ttest(tcp_demux)
+ttest(tcp_stack_driver)
+ttest(minnow_tcp_socket)
+ttest(packet_ring)
+ttest(neighbor_table)
+ttest(log_ring)
+ttest(prefix_trie)
+ttest(dir_24_8)
 ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
@@ -53,6 +68,13 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_pacing)
+ttest(send_bbr)
+ttest(send_rack_tlp)
+ttest(send_persist)
+ttest(send_window_scale)
+ttest(send_nagle)
+ttest(timer_wheel)
 
 ttest(net_interface)
 
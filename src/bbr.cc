@@ -0,0 +1,171 @@
+#include "bbr.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+BBR::BBR( uint64_t mss ) : mss_( mss ), cwnd_( INITIAL_CWND_SEGMENTS * mss ) {}
+
+void BBR::on_ack( uint64_t now_ms, const RateSample& rs, uint64_t bytes_in_flight )
+{
+  update_round( rs );
+  update_bandwidth( rs );
+  check_full_pipe();
+  update_min_rtt( now_ms, rs );
+  update_mode( now_ms, bytes_in_flight );
+  update_cwnd( rs );
+  update_pacing_rate();
+}
+
+uint64_t BBR::pacing_rate() const
+{
+  return pacing_rate_;
+}
+
+uint64_t BBR::cwnd() const
+{
+  if ( mode_ == Mode::ProbeRTT ) {
+    return min( cwnd_, MIN_CWND_SEGMENTS * mss_ );
+  }
+  return cwnd_;
+}
+
+// Bandwidth-delay product scaled by `gain`; falls back to the initial window until the model has samples.
+uint64_t BBR::bdp( uint64_t gain ) const
+{
+  const uint64_t bw = bottleneck_bandwidth();
+  if ( bw == 0 or not min_rtt_ms_.has_value() ) {
+    return INITIAL_CWND_SEGMENTS * mss_;
+  }
+  return bw * min_rtt_ms_.value() / 1000 * gain / GAIN_UNIT;
+}
+
+void BBR::update_round( const RateSample& rs )
+{
+  round_start_ = false;
+  if ( rs.prior_delivered >= next_round_delivered_ ) {
+    next_round_delivered_ = rs.delivered;
+    round_count_++;
+    round_start_ = true;
+  }
+}
+
+void BBR::update_bandwidth( const RateSample& rs )
+{
+  if ( not rs.has_rate ) {
+    return;
+  }
+  while ( not bw_samples_.empty() and bw_samples_.front().first + BW_WINDOW_ROUNDS <= round_count_ ) {
+    bw_samples_.pop_front();
+  }
+  while ( not bw_samples_.empty() and bw_samples_.back().second <= rs.delivery_rate ) {
+    bw_samples_.pop_back();
+  }
+  bw_samples_.emplace_back( round_count_, rs.delivery_rate );
+}
+
+// Leave Startup once three rounds in a row failed to grow the bandwidth estimate by 25%.
+void BBR::check_full_pipe()
+{
+  if ( filled_pipe_ or not round_start_ ) {
+    return;
+  }
+  const uint64_t bw = bottleneck_bandwidth();
+  if ( bw >= full_bw_ * 5 / 4 ) {
+    full_bw_ = bw;
+    full_bw_count_ = 0;
+    return;
+  }
+  if ( ++full_bw_count_ >= 3 ) {
+    filled_pipe_ = true;
+  }
+}
+
+void BBR::update_min_rtt( uint64_t now_ms, const RateSample& rs )
+{
+  min_rtt_expired_ = min_rtt_ms_.has_value() and now_ms > min_rtt_stamp_ + MIN_RTT_WINDOW_MS;
+  if ( rs.has_rtt and ( not min_rtt_ms_.has_value() or rs.rtt_ms <= min_rtt_ms_.value() or min_rtt_expired_ ) ) {
+    min_rtt_ms_ = rs.rtt_ms;
+    min_rtt_stamp_ = now_ms;
+  }
+}
+
+void BBR::enter_probe_bw( uint64_t now_ms )
+{
+  mode_ = Mode::ProbeBW;
+  cycle_index_ = 2; // start cruising rather than probing up or draining
+  cycle_stamp_ = now_ms;
+  pacing_gain_ = PROBE_BW_GAINS.at( cycle_index_ );
+  cwnd_gain_ = CWND_GAIN;
+}
+
+void BBR::update_mode( uint64_t now_ms, uint64_t bytes_in_flight )
+{
+  if ( mode_ == Mode::Startup and filled_pipe_ ) {
+    mode_ = Mode::Drain;
+    pacing_gain_ = DRAIN_GAIN;
+    cwnd_gain_ = HIGH_GAIN;
+  }
+  if ( mode_ == Mode::Drain and bytes_in_flight <= bdp( GAIN_UNIT ) ) {
+    enter_probe_bw( now_ms );
+  }
+
+  if ( mode_ == Mode::ProbeBW and min_rtt_ms_.has_value() ) {
+    const bool phase_over = now_ms - cycle_stamp_ > min_rtt_ms_.value();
+    const bool drained = pacing_gain_ < GAIN_UNIT and bytes_in_flight <= bdp( GAIN_UNIT );
+    if ( phase_over or drained ) {
+      cycle_index_ = ( cycle_index_ + 1 ) % PROBE_BW_GAINS.size();
+      cycle_stamp_ = now_ms;
+      pacing_gain_ = PROBE_BW_GAINS.at( cycle_index_ );
+    }
+  }
+
+  if ( min_rtt_expired_ and mode_ != Mode::ProbeRTT ) {
+    mode_ = Mode::ProbeRTT;
+    pacing_gain_ = GAIN_UNIT;
+    cwnd_gain_ = GAIN_UNIT;
+    probe_rtt_done_stamp_.reset();
+  }
+
+  if ( mode_ == Mode::ProbeRTT ) {
+    if ( not probe_rtt_done_stamp_.has_value() and bytes_in_flight <= MIN_CWND_SEGMENTS * mss_ ) {
+      probe_rtt_done_stamp_ = now_ms + PROBE_RTT_DURATION_MS;
+      probe_rtt_round_done_ = false;
+    } else if ( probe_rtt_done_stamp_.has_value() ) {
+      probe_rtt_round_done_ = probe_rtt_round_done_ or round_start_;
+      if ( probe_rtt_round_done_ and now_ms >= probe_rtt_done_stamp_.value() ) {
+        min_rtt_stamp_ = now_ms;
+        if ( filled_pipe_ ) {
+          enter_probe_bw( now_ms );
+        } else {
+          mode_ = Mode::Startup;
+          pacing_gain_ = HIGH_GAIN;
+          cwnd_gain_ = HIGH_GAIN;
+        }
+      }
+    }
+  }
+}
+
+void BBR::update_cwnd( const RateSample& rs )
+{
+  const uint64_t target = bdp( cwnd_gain_ );
+  if ( filled_pipe_ ) {
+    cwnd_ = min( cwnd_ + rs.newly_acked, target );
+  } else if ( cwnd_ < target or rs.delivered < INITIAL_CWND_SEGMENTS * mss_ ) {
+    cwnd_ += rs.newly_acked;
+  }
+  cwnd_ = max( cwnd_, MIN_CWND_SEGMENTS * mss_ );
+}
+
+// Until the pipe is full the pacing rate only ever goes up; it starts from HIGH_GAIN * initial window / RTT.
+void BBR::update_pacing_rate()
+{
+  if ( pacing_rate_ == 0 and min_rtt_ms_.has_value() ) {
+    pacing_rate_ = HIGH_GAIN * INITIAL_CWND_SEGMENTS * mss_ * 1000 / max<uint64_t>( min_rtt_ms_.value(), 1 ) / GAIN_UNIT;
+  }
+  const uint64_t rate = bottleneck_bandwidth() * pacing_gain_ / GAIN_UNIT;
+  if ( filled_pipe_ or rate > pacing_rate_ ) {
+    pacing_rate_ = rate;
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+
+/*
+ * A model-based congestion controller in the style of BBR (v1).
+ *
+ * Rather than reacting to loss, BBR keeps a model of the path: the bottleneck bandwidth (the maximum
+ * delivery rate seen over the last few round trips) and the minimum round-trip time (over the last
+ * ten seconds). It paces at a multiple of the bandwidth estimate and caps the data in flight at a
+ * multiple of the bandwidth-delay product.
+ *
+ * The TCPSender does the per-segment bookkeeping (how much had been delivered when each segment was
+ * sent) and feeds one RateSample per acknowledgment into on_ack().
+ */
+class BBR
+{
+public:
+  enum class Mode : uint8_t
+  {
+    Startup,  // exponential search for the bottleneck bandwidth
+    Drain,    // drain the queue built up during Startup
+    ProbeBW,  // cruise at the estimated bandwidth, periodically probing for more
+    ProbeRTT, // briefly shrink the window to re-measure the minimum RTT
+  };
+
+  struct RateSample
+  {
+    uint64_t delivery_rate {};   // bytes/s, valid only if `has_rate`
+    uint64_t rtt_ms {};          // valid only if `has_rtt`
+    uint64_t prior_delivered {}; // total bytes delivered when the sampled segment was sent
+    uint64_t delivered {};       // total bytes delivered now
+    uint64_t newly_acked {};     // bytes acknowledged by this ACK
+    bool has_rate {};
+    bool has_rtt {};
+  };
+
+  explicit BBR( uint64_t mss );
+
+  /* Update the model with the sample taken from an acknowledgment */
+  void on_ack( uint64_t now_ms, const RateSample& rs, uint64_t bytes_in_flight );
+
+  /* Rate to pace at, in bytes/s (0 until the first RTT sample) */
+  uint64_t pacing_rate() const;
+
+  /* Congestion window, in bytes */
+  uint64_t cwnd() const;
+
+  /* Accessors for use in testing */
+  Mode mode() const { return mode_; }
+  uint64_t bottleneck_bandwidth() const { return bw_samples_.empty() ? 0 : bw_samples_.front().second; }
+  std::optional<uint64_t> min_rtt() const { return min_rtt_ms_; }
+
+private:
+  static constexpr uint64_t GAIN_UNIT = 1000;      // gains are expressed in thousandths
+  static constexpr uint64_t HIGH_GAIN = 2885;      // 2/ln(2)
+  static constexpr uint64_t DRAIN_GAIN = 347;      // 1/HIGH_GAIN
+  static constexpr uint64_t CWND_GAIN = 2000;      // cwnd = 2 * BDP in steady state
+  static constexpr uint64_t BW_WINDOW_ROUNDS = 10; // bandwidth max-filter length
+  static constexpr uint64_t INITIAL_CWND_SEGMENTS = 10;
+  static constexpr uint64_t MIN_CWND_SEGMENTS = 4;
+  static constexpr uint64_t MIN_RTT_WINDOW_MS = 10000;
+  static constexpr uint64_t PROBE_RTT_DURATION_MS = 200;
+  static constexpr std::array<uint64_t, 8> PROBE_BW_GAINS = { 1250, 750, 1000, 1000, 1000, 1000, 1000, 1000 };
+
+  uint64_t mss_;
+  Mode mode_ { Mode::Startup };
+  uint64_t pacing_gain_ { HIGH_GAIN };
+  uint64_t cwnd_gain_ { HIGH_GAIN };
+  uint64_t cwnd_;
+  uint64_t pacing_rate_ {};
+
+  // Round-trip counting: a round ends when a segment sent after the previous round began is acked.
+  uint64_t round_count_ {};
+  uint64_t next_round_delivered_ {};
+  bool round_start_ {};
+
+  // Windowed max filter over (round, delivery rate), kept monotonically decreasing.
+  std::deque<std::pair<uint64_t, uint64_t>> bw_samples_ {};
+
+  std::optional<uint64_t> min_rtt_ms_ {};
+  uint64_t min_rtt_stamp_ {};
+  bool min_rtt_expired_ {};
+
+  // Startup exit detection
+  uint64_t full_bw_ {};
+  uint64_t full_bw_count_ {};
+  bool filled_pipe_ {};
+
+  // ProbeBW gain cycling
+  uint64_t cycle_index_ {};
+  uint64_t cycle_stamp_ {};
+
+  // ProbeRTT bookkeeping
+  std::optional<uint64_t> probe_rtt_done_stamp_ {};
+  bool probe_rtt_round_done_ {};
+
+  uint64_t bdp( uint64_t gain ) const;
+  void update_round( const RateSample& rs );
+  void update_bandwidth( const RateSample& rs );
+  void update_min_rtt( uint64_t now_ms, const RateSample& rs );
+  void check_full_pipe();
+  void update_mode( uint64_t now_ms, uint64_t bytes_in_flight );
+  void update_cwnd( const RateSample& rs );
+  void update_pacing_rate();
+  void enter_probe_bw( uint64_t now_ms );
+};
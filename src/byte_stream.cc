@@ -51,7 +51,18 @@ bool Writer::is_closed() const
 uint64_t Writer::available_capacity() const
 {
   // Your code here.
-  return capacity_ - buffer_.size();
+  return capacity_ > buffer_.size() ? capacity_ - buffer_.size() : 0;
+}
+
+uint64_t Writer::capacity() const
+{
+  return capacity_;
+}
+
+void Writer::set_capacity( uint64_t capacity )
+{
+  // 缩小时已经缓存的数据保留, 等读出之后才有新的空间
+  capacity_ = capacity;
 }
 
 uint64_t Writer::bytes_pushed() const
@@ -39,6 +39,8 @@ public:
 
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
+  uint64_t capacity() const;           // Maximum number of bytes the stream buffers
+  void set_capacity( uint64_t capacity ); // Resize the stream (never drops bytes already buffered)
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
 };
 
@@ -0,0 +1,61 @@
+#include "dir_24_8.hh"
+
+#include "prefix_trie.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+Dir24_8::Dir24_8() : first_level_( size_t { 1 } << 24 ) {}
+
+// 覆盖范围内的表项, 只要没有被更长的前缀占用, 就换成这个路由
+void Dir24_8::fill( Entry* entries, uint32_t count, Entry route )
+{
+  for ( uint32_t i = 0; i < count; i++ ) {
+    Entry& entry = entries[i];
+    if ( entry.extended ) {
+      continue; // 由调用者处理第二级表
+    }
+    if ( not entry.valid or entry.length <= route.length ) {
+      entry = route;
+    }
+  }
+}
+
+void Dir24_8::insert( uint32_t prefix, uint8_t prefix_length, uint32_t value )
+{
+  if ( value > MAX_VALUE ) {
+    throw out_of_range( "Dir24_8: value " + to_string( value ) + " does not fit in 24 bits" );
+  }
+  prefix_length = min<uint8_t>( prefix_length, 32 );
+  prefix &= PrefixTrie::mask( prefix_length );
+  const Entry route { value, prefix_length, false, true };
+
+  if ( prefix_length <= 24 ) {
+    const uint32_t first = prefix >> 8;
+    const uint32_t count = uint32_t { 1 } << ( 24 - prefix_length );
+    fill( &first_level_[first], count, route );
+    // 已经展开到第二级的表项, 在第二级里更新
+    for ( uint32_t index = first; index < first + count; index++ ) {
+      if ( first_level_[index].extended ) {
+        fill( &second_level_[uint32_t { first_level_[index].value } << 8], 256, route );
+      }
+    }
+    return;
+  }
+
+  // 比/24长: 先把这个第一级表项展开成256个第二级表项, 每个都继承原来的路由
+  Entry& entry = first_level_[prefix >> 8];
+  if ( not entry.extended ) {
+    const auto group = static_cast<uint32_t>( group_count() );
+    if ( group > MAX_VALUE ) {
+      throw out_of_range( "Dir24_8: out of second-level groups" );
+    }
+    second_level_.resize( second_level_.size() + 256, entry );
+    entry = { group, 0, true, true };
+  }
+  const uint32_t group_start = uint32_t { entry.value } << 8;
+  fill( &second_level_[group_start | ( prefix & 0xff )], uint32_t { 1 } << ( 32 - prefix_length ), route );
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/*
+ * A DIR-24-8 forwarding table (Gupta, Lin and McKeown, "Routing Lookups in Hardware at Memory
+ * Access Speeds"), for longest-prefix matching in one or two memory accesses.
+ *
+ * The first level has one entry for each of the 2^24 values of the top 24 bits of an address. An
+ * entry either holds the longest matching prefix of at most 24 bits, or, if some prefix longer than
+ * /24 starts under it, points to a 256-entry second-level group indexed by the last 8 bits. The
+ * first level takes 64 MiB no matter how few routes there are: memory is traded for lookups whose
+ * cost does not depend on the table.
+ *
+ * Every entry also records the length of the prefix it came from, so an insert is incremental: it
+ * overwrites exactly the entries it covers that no longer prefix has claimed (as in DPDK's
+ * rte_lpm). A /24 or longer touches one entry (or part of one group); a /8 touches 65536.
+ */
+class Dir24_8
+{
+public:
+  /* Values are stored in 24 bits */
+  static constexpr uint32_t MAX_VALUE = ( 1 << 24 ) - 1;
+
+  Dir24_8();
+
+  /* Add a prefix (the bits after `prefix_length` are ignored), or replace its value */
+  void insert( uint32_t prefix, uint8_t prefix_length, uint32_t value );
+
+  /* The value of the longest inserted prefix that matches `address` */
+  std::optional<uint32_t> lookup( uint32_t address ) const
+  {
+    Entry entry = first_level_[address >> 8];
+    if ( entry.extended ) {
+      entry = second_level_[uint32_t { entry.value } << 8 | ( address & 0xff )];
+    }
+    if ( not entry.valid ) {
+      return {};
+    }
+    return uint32_t { entry.value };
+  }
+
+  /* Number of second-level groups allocated */
+  size_t group_count() const { return second_level_.size() >> 8; }
+
+  /* Bytes allocated for both levels */
+  size_t memory_usage() const { return ( first_level_.capacity() + second_level_.capacity() ) * sizeof( Entry ); }
+
+private:
+  // 一个表项: value是路由的值, 或者(extended时)第二级表的组号
+  struct Entry
+  {
+    uint32_t value : 24;
+    uint32_t length : 6; // 来自多长的前缀
+    uint32_t extended : 1;
+    uint32_t valid : 1;
+  };
+  static_assert( sizeof( Entry ) == 4 );
+
+  std::vector<Entry> first_level_;
+  std::vector<Entry> second_level_ {};
+
+  static void fill( Entry* entries, uint32_t count, Entry route );
+};
@@ -0,0 +1,170 @@
+#include "minnow_tcp_socket.hh"
+#include "exception.hh"
+#include "random.hh"
+
+#include <array>
+#include <stdexcept>
+#include <sys/socket.h>
+
+using namespace std;
+
+MinnowTCPSocket::MinnowTCPSocket( FileDescriptor&& device, uint32_t local_address, const TCPConfig& config )
+  : driver_( move( device ), loop_, get_random_engine()() ), local_address_( local_address ), config_( config )
+{
+  loop_.add_timer( TCPStackDriver::TICK_MS, [this]( uint64_t elapsed ) { now_ms_ += elapsed; } );
+  driver_.set_activity_callback( [this] { observe(); } );
+}
+
+void MinnowTCPSocket::connect( const Address& address )
+{
+  if ( id_.has_value() ) {
+    throw runtime_error( "MinnowTCPSocket: already connected" );
+  }
+  // 随机选一个临时端口 (RFC 6335的动态端口范围)
+  auto rd = get_random_engine();
+  const auto local_port = static_cast<uint16_t>( uniform_int_distribution<uint16_t> { 49152, 65535 }( rd ) );
+  id_ = driver_.demux().connect( { local_address_, address.ipv4_numeric(), local_port, address.port() }, config_ );
+  driver_.flush();
+
+  const uint64_t deadline = now_ms_ + CONNECT_TIMEOUT_MS;
+  wait_until( [&] { return not alive() or peer().state() != TCPPeer::State::SynSent or now_ms_ >= deadline; } );
+  throw_if_error();
+  if ( peer().state() == TCPPeer::State::SynSent ) {
+    throw runtime_error( "MinnowTCPSocket: connect timed out" );
+  }
+}
+
+void MinnowTCPSocket::read( string& buffer )
+{
+  buffer.clear();
+  wait_until( [&] { return not alive() or peer().inbound_reader().bytes_buffered() > 0 or eof(); } );
+  throw_if_error();
+  if ( not driver_.demux().has_connection( id_.value() ) ) {
+    return; // 正常结束之后被释放了: EOF
+  }
+  Reader& reader = peer().inbound_reader();
+  while ( reader.bytes_buffered() ) {
+    buffer += reader.peek();
+    reader.pop( reader.peek().size() );
+  }
+  // 读走数据会打开接收窗口, 告诉对方
+  driver_.demux().push( id_.value() );
+  driver_.flush();
+}
+
+size_t MinnowTCPSocket::write( string_view data )
+{
+  size_t written = 0;
+  while ( written < data.size() ) {
+    wait_until( [&] { return not alive() or peer().outbound_writer().available_capacity() > 0; } );
+    throw_if_error();
+    if ( not alive() ) {
+      throw runtime_error( "MinnowTCPSocket: connection closed" );
+    }
+    Writer& writer = peer().outbound_writer();
+    const auto chunk = data.substr( written, writer.available_capacity() );
+    writer.push( string( chunk ) );
+    written += chunk.size();
+    driver_.demux().push( id_.value() );
+    driver_.flush();
+  }
+  return written;
+}
+
+void MinnowTCPSocket::close()
+{
+  if ( not alive() ) {
+    return;
+  }
+  peer().outbound_writer().close();
+  driver_.demux().push( id_.value() );
+  driver_.flush();
+  // TIME_WAIT不需要等: 只有对方的FIN重传需要它, 这里没有人会重用这个端口
+  wait_until( [&] { return not alive() or peer().state() == TCPPeer::State::TimeWait; } );
+}
+
+bool MinnowTCPSocket::eof() const
+{
+  if ( not id_.has_value() ) {
+    return false;
+  }
+  if ( not driver_.demux().has_connection( id_.value() ) ) {
+    return fin_received_ and not reset_; // 连接已经被释放了: 看释放之前记下的状态
+  }
+  return peer().inbound_reader().is_finished();
+}
+
+bool MinnowTCPSocket::alive() const
+{
+  return id_.has_value() and driver_.demux().has_connection( id_.value() ) and peer().active();
+}
+
+Address MinnowTCPSocket::local_address() const
+{
+  const auto& flow = driver_.demux().flow( id_.value() );
+  return Address { Address::from_ipv4_numeric( flow.local_address ).ip(), flow.local_port };
+}
+
+Address MinnowTCPSocket::peer_address() const
+{
+  const auto& flow = driver_.demux().flow( id_.value() );
+  return Address { Address::from_ipv4_numeric( flow.remote_address ).ip(), flow.remote_port };
+}
+
+pair<FileDescriptor, FileDescriptor> MinnowTCPSocket::local_link()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", socketpair( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+TCPPeer& MinnowTCPSocket::peer()
+{
+  if ( not id_.has_value() ) {
+    throw runtime_error( "MinnowTCPSocket: not connected" );
+  }
+  return driver_.demux().peer( id_.value() );
+}
+
+const TCPPeer& MinnowTCPSocket::peer() const
+{
+  if ( not id_.has_value() ) {
+    throw runtime_error( "MinnowTCPSocket: not connected" );
+  }
+  return driver_.demux().peer( id_.value() );
+}
+
+void MinnowTCPSocket::wait_until( const function<bool()>& done )
+{
+  observe();
+  while ( not done() ) {
+    if ( loop_.wait_next_event( -1 ) == EventLoop::Result::Exit ) {
+      throw runtime_error( "MinnowTCPSocket: device closed" );
+    }
+    observe();
+  }
+}
+
+// demux释放连接之后就看不到peer了: 每次有动静的时候记下入站流有没有结束或者出错
+void MinnowTCPSocket::observe()
+{
+  if ( id_.has_value() and driver_.demux().has_connection( id_.value() ) ) {
+    const Reader& reader = peer().inbound_reader();
+    fin_received_ = reader.writer().is_closed();
+    reset_ = reader.has_error();
+  }
+}
+
+void MinnowTCPSocket::throw_if_error() const
+{
+  if ( not id_.has_value() ) {
+    throw runtime_error( "MinnowTCPSocket: not connected" );
+  }
+  if ( driver_.demux().has_connection( id_.value() ) ? peer().inbound_reader().has_error() : reset_ ) {
+    throw runtime_error( "MinnowTCPSocket: connection reset" );
+  }
+  // 连接在收到FIN之前就没了(比如重传超时): 不是正常的EOF
+  if ( not driver_.demux().has_connection( id_.value() ) and not fin_received_ ) {
+    throw runtime_error( "MinnowTCPSocket: connection closed" );
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "tcp_config.hh"
+#include "tcp_stack_driver.hh"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/*
+ * A blocking, single-connection socket with the same connect/read/write/close surface as the kernel's
+ * TCPSocket, implemented with minnow's own TCP (TCPPeer, via TCPDemultiplexer and TCPStackDriver).
+ *
+ * The socket owns its EventLoop and runs it from inside each blocking call, so there are no threads.
+ * The device is normally a TunFD; for a connection between two stacks in the same process, use the
+ * two ends of local_link() and add the other stack's driver to this socket's event_loop().
+ */
+class MinnowTCPSocket
+{
+public:
+  /* Use `device` for datagrams, with `local_address` (host byte order) as this side's IPv4 address */
+  MinnowTCPSocket( FileDescriptor&& device, uint32_t local_address, const TCPConfig& config = {} );
+
+  /* Open a connection and wait until it's established (throws if it's refused or times out) */
+  void connect( const Address& address );
+
+  /* Wait until at least one byte is available and read what's there; empty at EOF */
+  void read( std::string& buffer );
+
+  /* Write all of `data`, waiting for room in the outbound stream; returns the # of bytes written */
+  size_t write( std::string_view data );
+
+  /* Finish the outbound stream and wait (up to the connection's linger time) for it to close */
+  void close();
+
+  /* Whether the inbound stream has ended (also once the closed connection has been released) */
+  bool eof() const;
+
+  /* The addresses of the connection */
+  Address local_address() const;
+  Address peer_address() const;
+
+  /* The event loop that drives this socket, for hosting other stacks or timers alongside it */
+  EventLoop& event_loop() { return loop_; }
+
+  /* A connected pair of datagram descriptors (AF_UNIX SOCK_SEQPACKET) that keep message boundaries,
+   * a stand-in for a TUN device when both ends of a connection run in this process */
+  static std::pair<FileDescriptor, FileDescriptor> local_link();
+
+  static constexpr uint64_t CONNECT_TIMEOUT_MS = 30000;
+
+private:
+  EventLoop loop_ {};
+  TCPStackDriver driver_;
+  uint32_t local_address_;
+  TCPConfig config_;
+  std::optional<TCPDemultiplexer::ConnectionId> id_ {};
+  uint64_t now_ms_ {}; // time according to the loop's timer
+  bool fin_received_ {}; // the inbound stream was closed by the peer (still known after the connection is reaped)
+  bool reset_ {};        // the connection was reset (ditto)
+
+  bool alive() const; // the connection exists and hasn't finished
+  TCPPeer& peer();
+  const TCPPeer& peer() const;
+  void wait_until( const std::function<bool()>& done );
+  void observe();
+  void throw_if_error() const;
+};
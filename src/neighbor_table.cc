@@ -0,0 +1,219 @@
+#include "neighbor_table.hh"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+NeighborTable::NeighborTable() : current_( new Snapshot {} ) {}
+
+NeighborTable::~NeighborTable()
+{
+  // 读者持有table的shared_ptr, 所以到这里已经没有读者了
+  delete current_.load();
+  for ( const auto& retired : retired_ ) {
+    delete retired.snapshot;
+  }
+}
+
+optional<NeighborTable::Entry> NeighborTable::lookup( uint32_t ip_address ) const
+{
+  // 先读时钟: tick()在前进时钟之前发布攒下的刷新, 看到新的时间就一定看到刷新之后的快照
+  const uint64_t now_ms = now_ms_.load( memory_order_acquire );
+  const Snapshot* snapshot = current_.load( memory_order_acquire );
+  const auto it = snapshot->find( ip_address );
+  if ( it == snapshot->end() or it->second.expires_ms <= now_ms ) {
+    return {};
+  }
+  return it->second;
+}
+
+void NeighborTable::publish( uint32_t ip_address, const EthernetAddress& ethernet_address, uint64_t ttl_ms )
+{
+  const lock_guard lock( writer_mutex_ );
+  const uint64_t expires_ms = now() + ttl_ms;
+  const Snapshot* snapshot = current_.load( memory_order_relaxed );
+  const auto it = snapshot->find( ip_address );
+  if ( it != snapshot->end() and it->second.ethernet_address == ethernet_address
+       and it->second.expires_ms > now() ) {
+    // 映射没有变, 只是延长有效期: 不复制快照, 等tick()一起发布
+    if ( expires_ms > it->second.expires_ms ) {
+      uint64_t& pending = pending_refreshes_[ip_address];
+      pending = max( pending, expires_ms );
+    }
+    return;
+  }
+  Snapshot next = copy_with_refreshes();
+  next[ip_address] = { ethernet_address, expires_ms };
+  replace( move( next ) );
+}
+
+void NeighborTable::erase( uint32_t ip_address )
+{
+  const lock_guard lock( writer_mutex_ );
+  if ( not current_.load( memory_order_relaxed )->contains( ip_address ) ) {
+    return;
+  }
+  pending_refreshes_.erase( ip_address );
+  Snapshot next = copy_with_refreshes();
+  next.erase( ip_address );
+  replace( move( next ) );
+}
+
+void NeighborTable::tick( uint64_t ms_since_last_tick )
+{
+  const lock_guard lock( writer_mutex_ );
+  const uint64_t now_ms = now() + ms_since_last_tick;
+  // 快照里的旧过期时间到了之前, 把攒下的刷新发布出去; 先发布再前进时钟, 读者不会看到一个提前过期的条目
+  const Snapshot* snapshot = current_.load( memory_order_relaxed );
+  const bool refresh_due = any_of( pending_refreshes_.begin(), pending_refreshes_.end(), [&]( const auto& refresh ) {
+    return snapshot->at( refresh.first ).expires_ms <= now_ms;
+  } );
+  if ( refresh_due ) {
+    replace( copy_with_refreshes() );
+  }
+  now_ms_.store( now_ms, memory_order_release );
+  reclaim();
+}
+
+size_t NeighborTable::size() const
+{
+  return current_.load( memory_order_acquire )->size();
+}
+
+size_t NeighborTable::retired_snapshots() const
+{
+  const lock_guard lock( writer_mutex_ );
+  return retired_.size();
+}
+
+uint64_t NeighborTable::snapshots_published() const
+{
+  const lock_guard lock( writer_mutex_ );
+  return published_;
+}
+
+// 调用者持有writer_mutex_
+NeighborTable::Snapshot NeighborTable::copy_with_refreshes()
+{
+  Snapshot next = *current_.load( memory_order_relaxed );
+  for ( const auto& [ip_address, expires_ms] : pending_refreshes_ ) {
+    next.at( ip_address ).expires_ms = expires_ms;
+  }
+  pending_refreshes_.clear();
+  return next;
+}
+
+// 调用者持有writer_mutex_
+void NeighborTable::replace( Snapshot&& next )
+{
+  // 顺便丢掉过期的条目: 反正要复制一次
+  const uint64_t now_ms = now();
+  erase_if( next, [now_ms]( const auto& entry ) { return entry.second.expires_ms <= now_ms; } );
+
+  const Snapshot* old = current_.exchange( new Snapshot( move( next ) ) );
+  // 在epoch前进之前还可能看到旧快照的读者, 宣布的epoch最多是这个值
+  retired_.push_back( { old, epoch_.fetch_add( 1 ) } );
+  published_++;
+  reclaim();
+}
+
+// 调用者持有writer_mutex_
+void NeighborTable::reclaim()
+{
+  if ( retired_.empty() ) {
+    return;
+  }
+  uint64_t oldest = numeric_limits<uint64_t>::max();
+  for ( const auto& epoch : reader_epochs_ ) {
+    const uint64_t seen = epoch->load();
+    if ( seen != 0 ) {
+      oldest = min( oldest, seen );
+    }
+  }
+  // 所有读者在这个快照退休之后都经过了静止状态, 不可能还在用它
+  erase_if( retired_, [oldest]( const Retired& retired ) {
+    if ( retired.epoch >= oldest ) {
+      return false;
+    }
+    delete retired.snapshot;
+    return true;
+  } );
+}
+
+pair<size_t, atomic<uint64_t>*> NeighborTable::add_reader()
+{
+  const lock_guard lock( writer_mutex_ );
+  size_t slot {};
+  if ( free_slots_.empty() ) {
+    slot = reader_epochs_.size();
+    reader_epochs_.push_back( make_unique<atomic<uint64_t>>() );
+  } else {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  }
+  // 新读者不可能拿着已经退休的快照
+  reader_epochs_[slot]->store( epoch_.load() );
+  return { slot, reader_epochs_[slot].get() };
+}
+
+void NeighborTable::remove_reader( size_t slot )
+{
+  const lock_guard lock( writer_mutex_ );
+  reader_epochs_.at( slot )->store( 0 );
+  free_slots_.push_back( slot );
+  reclaim();
+}
+
+NeighborTable::Reader::Reader( shared_ptr<NeighborTable> table ) : table_( move( table ) )
+{
+  if ( not table_ ) {
+    throw invalid_argument( "NeighborTable::Reader: null table" );
+  }
+  tie( slot_, epoch_ ) = table_->add_reader();
+}
+
+NeighborTable::Reader::Reader( const Reader& other ) : Reader( other.table_ ) {}
+
+NeighborTable::Reader::Reader( Reader&& other ) noexcept
+  : table_( move( other.table_ ) ), slot_( other.slot_ ), epoch_( exchange( other.epoch_, nullptr ) )
+{}
+
+NeighborTable::Reader& NeighborTable::Reader::operator=( const Reader& other )
+{
+  if ( this != &other ) {
+    *this = Reader( other );
+  }
+  return *this;
+}
+
+NeighborTable::Reader& NeighborTable::Reader::operator=( Reader&& other ) noexcept
+{
+  if ( this != &other ) {
+    release();
+    table_ = move( other.table_ );
+    slot_ = other.slot_;
+    epoch_ = exchange( other.epoch_, nullptr );
+  }
+  return *this;
+}
+
+NeighborTable::Reader::~Reader()
+{
+  release();
+}
+
+void NeighborTable::Reader::quiescent() const
+{
+  epoch_->store( table_->epoch_.load() );
+}
+
+void NeighborTable::Reader::release()
+{
+  if ( table_ ) {
+    table_->remove_reader( slot_ );
+    table_.reset();
+    epoch_ = nullptr;
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ethernet_frame.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * A neighbor (IP -> Ethernet address) cache that several NetworkInterfaces on the same broadcast
+ * domain can share, so that a neighbor resolved by one of them does not have to be resolved again
+ * by the others.
+ *
+ * Lookups are read-copy-update style: the table is an immutable snapshot behind an atomic pointer,
+ * and a lookup is one atomic load plus a hash lookup, with no lock. Updates (rare: they happen when
+ * an interface learns a mapping from ARP) copy the snapshot under a mutex, publish the copy, and
+ * retire the old snapshot. Retired snapshots are freed with quiescent-state-based reclamation:
+ * every reader announces a quiescent state from time to time (NetworkInterface does so on every
+ * tick()), and a snapshot is freed once every reader has done so after it was retired. Lookups
+ * return by value, so no reader holds a pointer into a snapshot across a quiescent state.
+ *
+ * Entries expire on the table's own clock, which the owner advances with tick() (once per elapsed
+ * interval, not once per attached interface).
+ *
+ * Republishing a mapping that is already in the snapshot (the usual case: every ARP message from a
+ * known neighbor refreshes it) does not copy the snapshot. The new expiry is kept aside, and tick()
+ * folds all such refreshes into one new snapshot just before the oldest of the stale expiries
+ * would pass (or the next real update carries them along). Until then a lookup reports the earlier
+ * expiry, which is still correct, only conservative.
+ */
+class NeighborTable
+{
+public:
+  struct Entry
+  {
+    EthernetAddress ethernet_address {};
+    uint64_t expires_ms {}; // on the table's clock
+  };
+
+  /*
+   * A registered reader of a table. Holding one keeps the table alive. Copies register as separate
+   * readers, so each copy has to announce its own quiescent states.
+   */
+  class Reader
+  {
+  public:
+    explicit Reader( std::shared_ptr<NeighborTable> table );
+    Reader( const Reader& other );
+    Reader( Reader&& other ) noexcept;
+    Reader& operator=( const Reader& other );
+    Reader& operator=( Reader&& other ) noexcept;
+    ~Reader();
+
+    /* Announce that this reader holds no reference into any snapshot */
+    void quiescent() const;
+
+    NeighborTable& table() const { return *table_; }
+
+  private:
+    std::shared_ptr<NeighborTable> table_;
+    size_t slot_ {};
+    std::atomic<uint64_t>* epoch_ {}; // this reader's entry in the table's reader_epochs_
+
+    void release();
+  };
+
+  NeighborTable();
+  ~NeighborTable();
+  NeighborTable( const NeighborTable& other ) = delete;
+  NeighborTable& operator=( const NeighborTable& other ) = delete;
+
+  /* The unexpired mapping for `ip_address`, if any. Never blocks. */
+  std::optional<Entry> lookup( uint32_t ip_address ) const;
+
+  /* Add or refresh a mapping that stays valid for `ttl_ms` (a refresh of an unchanged mapping is batched) */
+  void publish( uint32_t ip_address, const EthernetAddress& ethernet_address, uint64_t ttl_ms );
+
+  /* Remove a mapping (e.g. because it was found to be wrong) */
+  void erase( uint32_t ip_address );
+
+  /* Advance the table's clock, and free the snapshots that no reader can still be using */
+  void tick( uint64_t ms_since_last_tick );
+
+  /* The table's clock, in ms (the sum of all tick() arguments) */
+  uint64_t now() const { return now_ms_.load( std::memory_order_relaxed ); }
+
+  /* Accessors for use in testing */
+  size_t size() const;
+  size_t retired_snapshots() const;
+  uint64_t snapshots_published() const;
+
+private:
+  using Snapshot = std::unordered_map<uint32_t, Entry>;
+
+  struct Retired
+  {
+    const Snapshot* snapshot;
+    uint64_t epoch; // freed once every reader has announced a later epoch
+  };
+
+  // 当前的快照. 读者只做一次原子load, 不加锁
+  std::atomic<const Snapshot*> current_;
+  std::atomic<uint64_t> now_ms_ { 0 };
+  // 每次发布新快照都加一
+  std::atomic<uint64_t> epoch_ { 1 };
+
+  // 下面的成员由writer_mutex_保护
+  mutable std::mutex writer_mutex_ {};
+  std::vector<Retired> retired_ {};
+  // 每个读者最近一次宣布静止状态时看到的epoch (0表示这个位置没人用).
+  // 用unique_ptr是为了扩容时读者手上的位置不会移动
+  std::vector<std::unique_ptr<std::atomic<uint64_t>>> reader_epochs_ {};
+  std::vector<size_t> free_slots_ {};
+  uint64_t published_ {};
+  // 地址没有变的刷新: 新的过期时间先记在这里, 攒到一起发布 (见tick())
+  std::unordered_map<uint32_t, uint64_t> pending_refreshes_ {};
+
+  std::pair<size_t, std::atomic<uint64_t>*> add_reader();
+  void remove_reader( size_t slot );
+  Snapshot copy_with_refreshes();
+  void replace( Snapshot&& next );
+  void reclaim();
+};
@@ -2,17 +2,41 @@
 
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
+#include "log.hh"
+
+#include <algorithm>
 
 using namespace std;
 
 // ethernet_address: Ethernet (what ARP calls "hardware") address of the interface
 // ip_address: IP (what ARP calls "protocol") address of the interface
-NetworkInterface::NetworkInterface( const EthernetAddress& ethernet_address, const Address& ip_address )
-  : ethernet_address_( ethernet_address ), ip_address_( ip_address ), mappings_(),
-  ready_frames_(), unready_frames_()
+// config: optional ARP behavior (gratuitous ARP, proactive refresh)
+NetworkInterface::NetworkInterface( const EthernetAddress& ethernet_address,
+                                    const Address& ip_address,
+                                    const ARPConfig& config )
+  : ethernet_address_( ethernet_address ), ip_address_( ip_address ), config_( config ), mappings_(),
+  ready_frames_()
+{
+  // ip()会调用getnameinfo: 只在编译进了Debug级别的时候才格式化
+  if constexpr (Log::enabled(LogLevel::Debug)) {
+    Log::debug("Network interface has Ethernet address ", to_string(ethernet_address_), " and IP address ",
+               ip_address.ip());
+  }
+  config_.refresh_before_expiry_ms = min(config_.refresh_before_expiry_ms, MAPPING_TTL_MS - 1);
+  if (config_.gratuitous_arp) {
+    announce();
+  }
+}
+
+void NetworkInterface::attach_neighbor_table( shared_ptr<NeighborTable> table )
 {
-  cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address_ ) << " and IP address "
-       << ip_address.ip() << "\n";
+    shared_neighbors_.emplace(move(table));
+}
+
+// 发送gratuitous ARP (RFC 5227的announcement): 让同一个网段的主机马上学到(或更新)我们的映射
+void NetworkInterface::announce()
+{
+    send_arp_request(ip_address_.ipv4_numeric(), ETHERNET_BROADCAST);
 }
 
 // dgram: the IPv4 datagram to be sent
@@ -29,37 +53,30 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
      *  2. 如果Mac地址不知道的话，则广播这个ARP查询这个IP地址所对应的MAC地址，并存储起来这个<InternetDatagram, next_hop>,
      *      一旦接受到IP地址所对应的MAC地址，则发送该网络数据报。
      * */
-     EthernetFrame frame;
-    if (mappings_.contains(next_hop.ipv4_numeric())) {
-        auto [eAddress, time] = mappings_[next_hop.ipv4_numeric()];
-        frame.header.type = EthernetHeader::TYPE_IPv4;
-        frame.header.dst = eAddress;
-        frame.header.src = ethernet_address_;
-        frame.payload = serialize(dgram);
-        ready_frames_.push_back(frame);
+    auto mapping = mappings_.find(next_hop.ipv4_numeric());
+    if (mapping != mappings_.end()) {
+        mapping->second.used = true;
+        send_frame(dgram, mapping->second);
+
+    } else if (adopt_shared_mapping(next_hop.ipv4_numeric())) {
+        send_frame(dgram, mappings_.at(next_hop.ipv4_numeric()));
 
     } else {
         //ARP映射表中没有查询到Mac地址，所以需要发送ARP请求信息
-        unready_frames_.emplace_back(dgram, next_hop);
+        auto& pending = pending_datagrams_[next_hop.ipv4_numeric()];
+        if (pending.size() >= MAX_PENDING_PER_HOP) {
+            // 队列满了: 丢弃最旧的, 新的数据报更有用
+            pending.pop_front();
+            pending_dropped_++;
+        }
+        pending.push_back(dgram);
 
         // 如果ARP请求从没有发送过
         if (!arp_times_.contains(next_hop.ipv4_numeric())) {
-          arp_times_[next_hop.ipv4_numeric()] = timestamp_;
-          // 创建ARP Message
-          ARPMessage arpMessage;
-          arpMessage.opcode = ARPMessage::OPCODE_REQUEST;
-          arpMessage.sender_ip_address = ip_address_.ipv4_numeric();
-          arpMessage.sender_ethernet_address = ethernet_address_;
-          arpMessage.target_ip_address = next_hop.ipv4_numeric();
-          arpMessage.target_ethernet_address = {};
-
-
-          // 创建Ethernet Message
-          frame.header.src = ethernet_address_;
-          frame.header.dst = ETHERNET_BROADCAST;
-          frame.header.type = EthernetHeader::TYPE_ARP;
-          frame.payload = serialize(arpMessage);
-          ready_frames_.push_back(frame);
+          const auto timer = expiry_.add_timer(ARP_REQUEST_KEY | next_hop.ipv4_numeric());
+          expiry_.arm(timer, expiry_.now() + ARP_REQUEST_TTL_MS);
+          arp_times_[next_hop.ipv4_numeric()] = timer;
+          send_arp_request(next_hop.ipv4_numeric(), ETHERNET_BROADCAST);
         }
 
     }
@@ -71,7 +88,8 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
     if (frame.header.type == EthernetHeader::TYPE_IPv4) {
         // 如果该Ethernet的Header.type == TYPE_IPv4, 说明传输过来的是数据包，所以直接把数据向上传输
         InternetDatagram dgram;
-        if (parse(dgram, frame.payload) && frame.header.dst == ethernet_address_) {
+        // 先检查地址: 不是发给我们的帧不需要解析
+        if (frame.header.dst == ethernet_address_ && parse(dgram, frame.payload)) {
           return dgram;
         }
 
@@ -80,17 +98,8 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
         if (parse(arpMessage, frame.payload)) {
             auto sender_ip = arpMessage.sender_ip_address;
             auto sender_ethernet = arpMessage.sender_ethernet_address;
-            mappings_[sender_ip] = make_pair(sender_ethernet, timestamp_);
-            if (arp_times_.contains(sender_ip)) {
-              arp_times_.erase(sender_ip);
-            }
-            while (!unready_frames_.empty()) {
-                auto [dgram, addr] = unready_frames_.front();
-                if (mappings_.contains(addr.ipv4_numeric())) {
-                    send_datagram(dgram, addr);
-                    unready_frames_.pop_front();
-                }
-            }
+            learn_mapping(sender_ip, sender_ethernet);
+            send_pending(sender_ip);
             if (arpMessage.opcode == ARPMessage::OPCODE_REQUEST && arpMessage.target_ip_address == ip_address_.ipv4_numeric()) {
                 // 如果发送的ARP信息并且是想知道我的IP地址所对应的MAC地址
                 ARPMessage message;
@@ -105,7 +114,7 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
                 reply_frame.header.src = ethernet_address_;
                 reply_frame.header.dst = arpMessage.sender_ethernet_address;
                 reply_frame.payload = serialize(message);
-                ready_frames_.push_back(reply_frame);
+                queue_frame(reply_frame);
             }
 
         }
@@ -113,29 +122,172 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
     return {};
 }
 
+size_t NetworkInterface::recv_frames( span<const EthernetFrame> frames, vector<InternetDatagram>& out )
+{
+    const size_t before = out.size();
+    for (const auto& frame : frames) {
+        auto dgram = recv_frame(frame);
+        if (dgram.has_value()) {
+            out.push_back(move(dgram.value()));
+        }
+    }
+    return out.size() - before;
+}
+
+// 创建ARP请求: 广播, 或者发给已知的邻居(刷新映射)
+void NetworkInterface::send_arp_request( uint32_t target_ip_address, const EthernetAddress& dst )
+{
+    ARPMessage arpMessage;
+    arpMessage.opcode = ARPMessage::OPCODE_REQUEST;
+    arpMessage.sender_ip_address = ip_address_.ipv4_numeric();
+    arpMessage.sender_ethernet_address = ethernet_address_;
+    arpMessage.target_ip_address = target_ip_address;
+    arpMessage.target_ethernet_address = {};
+
+    EthernetFrame frame;
+    frame.header.src = ethernet_address_;
+    frame.header.dst = dst;
+    frame.header.type = EthernetHeader::TYPE_ARP;
+    frame.payload = serialize(arpMessage);
+    queue_frame(frame);
+}
+
 // ms_since_last_tick: the number of milliseconds since the last call to this method
 void NetworkInterface::tick( const size_t ms_since_last_tick )
 {
-  timestamp_ += ms_since_last_tick;
-  auto arp_iter = arp_times_.begin();
-  while (arp_iter != arp_times_.end()) {
-        if (timestamp_ - arp_iter->second >= 5000) {
-            arp_times_.erase(arp_iter++);
-        } else {
-            arp_iter++;
-        }
+  // 只有过期的映射和ARP请求才会被处理
+  expiry_.tick(ms_since_last_tick, [this](uint64_t key) { expire(key); });
+  // 两次tick之间不会拿着共享邻居表快照里的指针
+  if (shared_neighbors_.has_value()) {
+    shared_neighbors_->quiescent();
   }
-  // 刪除过期的映射
-  auto map_iter = mappings_.begin();
-  while (map_iter != mappings_.end()) {
-        auto [eAddr, time] = map_iter->second;
-        if (timestamp_ - time >= 30000) {
-            mappings_.erase(map_iter++);
-        } else {
-            map_iter++;
+}
+
+// 记录(或更新)一个映射, 并取消对这个地址的ARP请求限制; 定时器由调用者设置
+NetworkInterface::Neighbor& NetworkInterface::remember_mapping( uint32_t ip_address,
+                                                               const EthernetAddress& ethernet_address )
+{
+    auto mapping = mappings_.find(ip_address);
+    if (mapping == mappings_.end()) {
+        mapping = mappings_.emplace(ip_address, Neighbor {{}, expiry_.add_timer(ip_address), {}}).first;
+    }
+    Neighbor& neighbor = mapping->second;
+    if (neighbor.header.empty() || neighbor.ethernet_address != ethernet_address) {
+        // 地址变了(或者是新的邻居): 重新编码header
+        neighbor.ethernet_address = ethernet_address;
+        const EthernetHeader header {ethernet_address, ethernet_address_, EthernetHeader::TYPE_IPv4};
+        Serializer serializer;
+        header.serialize(serializer);
+        neighbor.header = serializer.output().back();
+    }
+
+    auto request = arp_times_.find(ip_address);
+    if (request != arp_times_.end()) {
+        expiry_.remove_timer(request->second);
+        arp_times_.erase(request);
+    }
+    return neighbor;
+}
+
+// 从ARP学到(或刷新)一个映射
+void NetworkInterface::learn_mapping( uint32_t ip_address, const EthernetAddress& ethernet_address )
+{
+    Neighbor& neighbor = remember_mapping(ip_address, ethernet_address);
+    // 开启刷新时, 定时器先在过期前refresh_before_expiry_ms触发
+    neighbor.used = false;
+    neighbor.refresh_due = config_.refresh_before_expiry_ms > 0;
+    expiry_.arm(neighbor.timer, expiry_.now() + MAPPING_TTL_MS - config_.refresh_before_expiry_ms);
+
+    if (shared_neighbors_.has_value()) {
+        shared_neighbors_->table().publish(ip_address, ethernet_address, MAPPING_TTL_MS);
+    }
+}
+
+// 同一个网段的其它接口已经知道这个邻居: 直接用它的映射, 剩下的寿命也一样.
+// 我们不刷新这个映射, 刷新由学到它的接口负责
+bool NetworkInterface::adopt_shared_mapping( uint32_t ip_address )
+{
+    if (!shared_neighbors_.has_value()) {
+        return false;
+    }
+    const NeighborTable& table = shared_neighbors_->table();
+    const auto shared = table.lookup(ip_address);
+    if (!shared.has_value()) {
+        return false;
+    }
+    const uint64_t now = table.now();
+    Neighbor& neighbor = remember_mapping(ip_address, shared->ethernet_address);
+    neighbor.used = true;
+    neighbor.refresh_due = false;
+    expiry_.arm(neighbor.timer, expiry_.now() + (shared->expires_ms > now ? shared->expires_ms - now : 1));
+    neighbors_adopted_++;
+    send_pending(ip_address);
+    return true;
+}
+
+// 只发送等待这个地址的数据报
+void NetworkInterface::send_pending( uint32_t ip_address )
+{
+    auto pending = pending_datagrams_.find(ip_address);
+    if (pending != pending_datagrams_.end()) {
+        for (const auto& dgram : pending->second) {
+            send_frame(dgram, mappings_.at(ip_address));
         }
-  }
+        pending_datagrams_.erase(pending);
+    }
+}
 
+void NetworkInterface::expire( uint64_t key )
+{
+    const auto ip_address = static_cast<uint32_t>(key);
+    if (key & ARP_REQUEST_KEY) {
+        expiry_.remove_timer(arp_times_.at(ip_address));
+        arp_times_.erase(ip_address);
+    } else {
+        Neighbor& neighbor = mappings_.at(ip_address);
+        if (neighbor.refresh_due) {
+            // 快要过期了: 如果最近用过这个映射, 就单播一个ARP请求来刷新它.
+            // 在回复到来之前(或者真正过期之前)继续使用旧的映射
+            neighbor.refresh_due = false;
+            if (neighbor.used) {
+                send_arp_request(ip_address, neighbor.ethernet_address);
+                refreshes_sent_++;
+            }
+            expiry_.arm(neighbor.timer, expiry_.now() + config_.refresh_before_expiry_ms);
+            return;
+        }
+        expiry_.remove_timer(neighbor.timer);
+        mappings_.erase(ip_address);
+    }
+}
+
+void NetworkInterface::send_frame( const InternetDatagram& dgram, const Neighbor& neighbor )
+{
+    // 共享邻居的header; 只有IPv4 header需要编码, payload的Buffer也是共享的
+    ReadyFrame frame {{neighbor.ethernet_address, ethernet_address_, EthernetHeader::TYPE_IPv4}, {}};
+    frame.wire.reserve(dgram.payload.size() + 2);
+    frame.wire.push_back(neighbor.header);
+    Serializer serializer;
+    dgram.header.serialize(serializer);
+    frame.wire.push_back(serializer.output().back());
+    frame.wire.insert(frame.wire.end(), dgram.payload.begin(), dgram.payload.end());
+    ready_frames_.push_back(move(frame));
+}
+
+void NetworkInterface::queue_frame( const EthernetFrame& frame )
+{
+    ReadyFrame ready {frame.header, {}};
+    Serializer serializer;
+    frame.header.serialize(serializer);
+    ready.wire.push_back(serializer.output().back());
+    ready.wire.insert(ready.wire.end(), frame.payload.begin(), frame.payload.end());
+    ready_frames_.push_back(move(ready));
+}
+
+size_t NetworkInterface::pending_datagrams( const Address& next_hop ) const
+{
+    auto pending = pending_datagrams_.find(next_hop.ipv4_numeric());
+    return pending == pending_datagrams_.end() ? 0 : pending->second.size();
 }
 
 optional<EthernetFrame> NetworkInterface::maybe_send()
@@ -143,8 +295,42 @@ optional<EthernetFrame> NetworkInterface::maybe_send()
     if (ready_frames_.empty()) {
         return {};
     }
-    auto frame = ready_frames_.front();
+    ReadyFrame& ready = ready_frames_.front();
+    EthernetFrame frame {ready.header, {}};
+    frame.payload.assign(make_move_iterator(ready.wire.begin() + 1), make_move_iterator(ready.wire.end()));
     ready_frames_.pop_front();
     return frame;
 }
 
+optional<vector<Buffer>> NetworkInterface::maybe_send_serialized()
+{
+    if (ready_frames_.empty()) {
+        return {};
+    }
+    vector<Buffer> wire = move(ready_frames_.front().wire);
+    ready_frames_.pop_front();
+    return wire;
+}
+
+size_t NetworkInterface::drain_frames( vector<EthernetFrame>& out )
+{
+    const size_t count = ready_frames_.size();
+    out.reserve(out.size() + count);
+    for (auto& ready : ready_frames_) {
+        EthernetFrame& frame = out.emplace_back(EthernetFrame {ready.header, {}});
+        frame.payload.assign(make_move_iterator(ready.wire.begin() + 1), make_move_iterator(ready.wire.end()));
+    }
+    ready_frames_.clear();
+    return count;
+}
+
+size_t NetworkInterface::drain_frames( vector<vector<Buffer>>& out )
+{
+    const size_t count = ready_frames_.size();
+    out.reserve(out.size() + count);
+    for (auto& ready : ready_frames_) {
+        out.push_back(move(ready.wire));
+    }
+    ready_frames_.clear();
+    return count;
+}
@@ -3,14 +3,28 @@
 #include "address.hh"
 #include "ethernet_frame.hh"
 #include "ipv4_datagram.hh"
+#include "neighbor_table.hh"
+#include "timer_wheel.hh"
 
 #include <iostream>
 #include <list>
+#include <memory>
 #include <optional>
 #include <queue>
+#include <span>
 #include <unordered_map>
 #include <utility>
 
+// Optional ARP behavior beyond the basics (everything is off by default)
+struct ARPConfig
+{
+  // Announce our own mapping with a gratuitous ARP when the interface is created
+  bool gratuitous_arp = false;
+  // If nonzero, this long before a mapping that has been used expires, ask the neighbor again
+  // with a unicast ARP request, and keep using the old mapping until the reply (or the expiry)
+  uint64_t refresh_before_expiry_ms = 0;
+};
+
 // A "network interface" that connects IP (the internet layer, or network layer)
 // with Ethernet (the network access layer, or link layer).
 
@@ -41,27 +55,94 @@ private:
   // IP (known as Internet-layer or network-layer) address of the interface
   Address ip_address_;
 
-  // 映射: IP地址 -> EthernetAddress
-  std::unordered_map<uint32_t, std::pair<EthernetAddress, size_t >> mappings_{};
-
-  // 要发送的帧, 因为这些帧已经知道了它们目的地址的Mac地址
-  std::deque<EthernetFrame> ready_frames_;
-  // 未发送的帧，因为不知道当前的目的地址的Mac地址，所以暂存起来
-  std::deque<std::pair<InternetDatagram, Address>> unready_frames_;
-
-
-  size_t timestamp_{0};
-  std::unordered_map<uint32_t, uint64_t> arp_times_{};
-
+  ARPConfig config_;
+
+  // 一个已知的邻居
+  struct Neighbor
+  {
+    EthernetAddress ethernet_address;
+    TimerWheel::TimerId timer; // 映射过期的定时器
+    Buffer header;             // 发给这个邻居的IPv4帧的Ethernet header, 已经编码好了, 每个帧共享
+    bool used {};              // 上次学到映射之后发送过数据报
+    bool refresh_due {};       // 定时器下次触发时是刷新, 而不是过期
+  };
+
+  // 映射: IP地址 -> 邻居
+  std::unordered_map<uint32_t, Neighbor> mappings_{};
+
+  // 要发送的帧, 因为这些帧已经知道了它们目的地址的Mac地址.
+  // wire是帧在线路上的格式: 第一个Buffer是编码好的Ethernet header, 后面是payload
+  struct ReadyFrame
+  {
+    EthernetHeader header;
+    std::vector<Buffer> wire;
+  };
+  std::deque<ReadyFrame> ready_frames_;
+  // 未发送的数据报, 按next hop的IP地址分组: 收到ARP回复时只需要取出这个地址的队列
+  std::unordered_map<uint32_t, std::deque<InternetDatagram>> pending_datagrams_{};
+  // 因为等待队列满了而丢弃的数据报
+  uint64_t pending_dropped_{0};
+
+
+  // 映射和ARP请求的过期时间都放在timer wheel里: tick()只处理真正过期的条目, 不需要扫描整个表
+  TimerWheel expiry_{};
+  // 最近发送过ARP请求的IP地址 -> 定时器 (5秒之内不再重复发送)
+  std::unordered_map<uint32_t, TimerWheel::TimerId> arp_times_{};
+
+  // 定时器的key: 低32位是IP地址, 高位区分映射和ARP请求
+  static constexpr uint64_t ARP_REQUEST_KEY = uint64_t { 1 } << 32;
+  static constexpr uint64_t MAPPING_TTL_MS = 30000;
+  static constexpr uint64_t ARP_REQUEST_TTL_MS = 5000;
+
+  // 发送过的刷新请求
+  uint64_t refreshes_sent_{0};
+
+  // 和同一个网段的其它接口共享的邻居表 (可选)
+  std::optional<NeighborTable::Reader> shared_neighbors_{};
+  // 从共享邻居表里直接拿到的映射
+  uint64_t neighbors_adopted_{0};
+
+  Neighbor& remember_mapping( uint32_t ip_address, const EthernetAddress& ethernet_address );
+  void learn_mapping( uint32_t ip_address, const EthernetAddress& ethernet_address );
+  void send_pending( uint32_t ip_address );
+  bool adopt_shared_mapping( uint32_t ip_address );
+  void send_arp_request( uint32_t target_ip_address, const EthernetAddress& dst );
+  void expire( uint64_t key );
+
+
+  // Encapsulate a datagram in a frame to a known neighbor and queue it for sending
+  void send_frame( const InternetDatagram& dgram, const Neighbor& neighbor );
+  // Queue any other frame (e.g. ARP), serializing its header
+  void queue_frame( const EthernetFrame& frame );
 
 public:
+  // Datagrams held per next hop while its Ethernet address is being resolved; beyond this, the
+  // oldest are dropped (like Linux's unres_qlen)
+  static constexpr size_t MAX_PENDING_PER_HOP = 64;
+
   // Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer)
   // addresses
-  NetworkInterface( const EthernetAddress& ethernet_address, const Address& ip_address );
+  NetworkInterface( const EthernetAddress& ethernet_address, const Address& ip_address, const ARPConfig& config = {} );
+
+  // Send a gratuitous ARP announcing this interface's mapping
+  void announce();
+
+  // Share neighbors with the other interfaces attached to `table`: mappings this interface learns
+  // from ARP are published there, and a next hop it does not know is looked up there before
+  // falling back to an ARP request. The lookup never takes a lock.
+  void attach_neighbor_table( std::shared_ptr<NeighborTable> table );
 
   // Access queue of Ethernet frames awaiting transmission
   std::optional<EthernetFrame> maybe_send();
 
+  // The same, but already in wire format (header first, then the payload), for writing to a raw socket
+  std::optional<std::vector<Buffer>> maybe_send_serialized();
+
+  // Move every frame awaiting transmission to the end of `out` (one message per frame, as for
+  // sendmmsg(2)); returns the number of frames moved
+  size_t drain_frames( std::vector<EthernetFrame>& out );
+  size_t drain_frames( std::vector<std::vector<Buffer>>& out );
+
   // Sends an IPv4 datagram, encapsulated in an Ethernet frame (if it knows the Ethernet destination
   // address). Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address
   // for the next hop.
@@ -75,6 +156,22 @@ public:
   // If type is ARP reply, learn a mapping from the "sender" fields.
   std::optional<InternetDatagram> recv_frame( const EthernetFrame& frame );
 
+  // Receive a batch of frames (e.g. from recvmmsg(2)), appending the IPv4 datagrams among them to
+  // `out`; returns the number of datagrams appended
+  size_t recv_frames( std::span<const EthernetFrame> frames, std::vector<InternetDatagram>& out );
+
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
+
+  // Datagrams waiting for `next_hop`'s Ethernet address
+  size_t pending_datagrams( const Address& next_hop ) const;
+
+  // Datagrams dropped because their next hop's queue was full
+  uint64_t pending_dropped() const { return pending_dropped_; }
+
+  // Unicast ARP requests sent to refresh mappings before they expire
+  uint64_t refreshes_sent() const { return refreshes_sent_; }
+
+  // Mappings taken from the shared neighbor table instead of being resolved with ARP
+  uint64_t neighbors_adopted() const { return neighbors_adopted_; }
 };
@@ -0,0 +1,138 @@
+#include "prefix_trie.hh"
+
+#include <algorithm>
+#include <bit>
+#include <span>
+
+using namespace std;
+
+PrefixTrie::PrefixTrie() : nodes_( 1 ), direct_( size_t { 1 } << DIRECT_BITS ) {}
+
+uint32_t PrefixTrie::add_node( uint32_t prefix, uint8_t length )
+{
+  nodes_.push_back( { prefix, 0, { NONE, NONE }, length, false } );
+  return static_cast<uint32_t>( nodes_.size() - 1 );
+}
+
+void PrefixTrie::insert( uint32_t prefix, uint8_t prefix_length, uint32_t value )
+{
+  prefix_length = min<uint8_t>( prefix_length, 32 );
+  prefix &= mask( prefix_length );
+
+  // 注意: add_node()会让nodes_扩容, 所以这里只保存下标
+  uint32_t current = 0;
+  uint32_t branch = NONE; // 新加的分支节点
+  while ( nodes_[current].length < prefix_length ) {
+    const unsigned direction = bit( prefix, nodes_[current].length );
+    const uint32_t child = nodes_[current].child[direction];
+    if ( child == NONE ) {
+      current = nodes_[current].child[direction] = add_node( prefix, prefix_length );
+      break;
+    }
+
+    // 新前缀和子节点共同的前缀长度
+    const Node& existing = nodes_[child];
+    const auto common = static_cast<uint8_t>(
+      min( { prefix_length, existing.length, static_cast<uint8_t>( countl_zero( prefix ^ existing.prefix ) ) } ) );
+    if ( common == existing.length ) {
+      // 子节点是新前缀的前缀: 继续往下走
+      current = child;
+      continue;
+    }
+
+    const unsigned existing_direction = bit( existing.prefix, common );
+    uint32_t parent {};
+    if ( common == prefix_length ) {
+      // 新前缀是子节点的前缀: 插在它们之间
+      parent = add_node( prefix, prefix_length );
+    } else {
+      // 在它们分叉的地方加一个分支节点
+      parent = branch = add_node( prefix & mask( common ), common );
+      nodes_[parent].child[existing_direction ^ 1] = add_node( prefix, prefix_length );
+    }
+    nodes_[parent].child[existing_direction] = child;
+    nodes_[current].child[direction] = parent;
+    current = common == prefix_length ? parent : nodes_[parent].child[existing_direction ^ 1];
+    break;
+  }
+
+  Node& node = nodes_[current];
+  if ( not node.has_value ) {
+    node.has_value = true;
+    size_++;
+  }
+  node.value = value;
+
+  // 分支节点比新节点短, 先更新它覆盖的条目
+  if ( branch != NONE and nodes_[branch].length <= DIRECT_BITS ) {
+    refresh_direct( branch );
+  }
+  if ( prefix_length <= DIRECT_BITS ) {
+    refresh_direct( current );
+  }
+}
+
+// 用一个新加的(或者值变了的)节点更新它覆盖的直接索引条目, 不用从根往下走
+void PrefixTrie::refresh_direct( uint32_t index )
+{
+  const Node& node = nodes_[index];
+  const uint32_t first = node.prefix >> ( 32 - DIRECT_BITS );
+  const uint32_t count = uint32_t { 1 } << ( DIRECT_BITS - node.length );
+  for ( DirectEntry& entry : span( direct_ ).subspan( first, count ) ) {
+    // 条目里比它短的节点一定是它的祖先, 从它开始找更近; 比它长的是它的后代, 保持不变
+    if ( nodes_[entry.node].length < node.length ) {
+      entry.node = index;
+    }
+    // 同样, 来自更长前缀的匹配优先; 长度相同说明就是这个节点原来的值
+    if ( node.has_value and ( not entry.has_value or entry.value_length <= node.length ) ) {
+      entry.value = node.value;
+      entry.value_length = node.length;
+      entry.has_value = true;
+    }
+  }
+}
+
+optional<uint32_t> PrefixTrie::find( uint32_t prefix, uint8_t prefix_length ) const
+{
+  prefix_length = min<uint8_t>( prefix_length, 32 );
+  prefix &= mask( prefix_length );
+
+  uint32_t current = 0;
+  while ( nodes_[current].length < prefix_length ) {
+    current = nodes_[current].child[bit( prefix, nodes_[current].length )];
+    if ( current == NONE or ( prefix & mask( nodes_[current].length ) ) != nodes_[current].prefix ) {
+      return {};
+    }
+  }
+  const Node& node = nodes_[current];
+  if ( node.length != prefix_length or not node.has_value ) {
+    return {};
+  }
+  return node.value;
+}
+
+optional<uint32_t> PrefixTrie::lookup( uint32_t address ) const
+{
+  // 前16位直接查表, 剩下的在树里找
+  const DirectEntry& entry = direct_[address >> ( 32 - DIRECT_BITS )];
+  optional<uint32_t> best {};
+  if ( entry.has_value ) {
+    best = entry.value;
+  }
+  const Node* node = &nodes_[entry.node];
+  while ( node->length < 32 ) {
+    const uint32_t child = node->child[bit( address, node->length )];
+    if ( child == NONE ) {
+      break;
+    }
+    node = &nodes_[child];
+    // 被压缩掉的位也要匹配
+    if ( ( address & mask( node->length ) ) != node->prefix ) {
+      break;
+    }
+    if ( node->has_value ) {
+      best = node->value;
+    }
+  }
+  return best;
+}
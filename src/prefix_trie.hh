@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/*
+ * A path-compressed binary trie (a Patricia trie) of IPv4 prefixes, for longest-prefix matching.
+ *
+ * Every node is a prefix; a node only exists if it holds a route or if two of its descendants
+ * diverge right after it, so chains of single-child nodes are skipped over and the trie has fewer
+ * than two nodes per route. A lookup walks down from the root, one node per branching point on
+ * the path to the address, remembering the last node that held a route. Inserting a prefix adds at
+ * most two nodes.
+ *
+ * As in Poptrie, the first 16 bits are resolved by direct pointing: a table indexed by the top 16
+ * bits of the address holds the deepest node of at most 16 bits on that path and the longest match
+ * found so far, so a lookup starts there instead of at the root. An insert that adds or changes a
+ * node of at most 16 bits updates the entries that node covers in place, comparing prefix lengths,
+ * without walking the trie again; for the usual prefixes longer than /16 there is nothing to do.
+ *
+ * Nodes live in one vector and refer to their children by index, which keeps them small (20
+ * bytes) and close together.
+ */
+class PrefixTrie
+{
+public:
+  PrefixTrie();
+
+  /* Add a prefix (the bits after `prefix_length` are ignored), or replace its value */
+  void insert( uint32_t prefix, uint8_t prefix_length, uint32_t value );
+
+  /* The value of exactly this prefix, if it has been inserted */
+  std::optional<uint32_t> find( uint32_t prefix, uint8_t prefix_length ) const;
+
+  /* The value of the longest inserted prefix that matches `address` */
+  std::optional<uint32_t> lookup( uint32_t address ) const;
+
+  /* Number of prefixes inserted */
+  size_t size() const { return size_; }
+
+  /* Number of trie nodes, including the root and the branching points */
+  size_t node_count() const { return nodes_.size(); }
+
+  /* Bytes allocated for nodes and the direct-pointing table */
+  size_t memory_usage() const
+  {
+    return nodes_.capacity() * sizeof( Node ) + direct_.capacity() * sizeof( DirectEntry );
+  }
+
+  /* Mask with the top `prefix_length` bits set */
+  static constexpr uint32_t mask( uint8_t prefix_length )
+  {
+    return prefix_length == 0 ? 0 : ~uint32_t { 0 } << ( 32 - prefix_length );
+  }
+
+private:
+  static constexpr uint32_t NONE = 0; // the root is nobody's child
+
+  struct Node
+  {
+    uint32_t prefix {};
+    uint32_t value {};
+    uint32_t child[2] { NONE, NONE };
+    uint8_t length {};
+    uint8_t has_value {};
+  };
+
+  static constexpr uint8_t DIRECT_BITS = 16;
+
+  // 地址的前16位 -> 从哪个节点开始往下找, 以及到这个节点为止最长的匹配
+  struct DirectEntry
+  {
+    uint32_t node {};
+    uint32_t value {};
+    uint8_t value_length {}; // value来自多长的前缀
+    uint8_t has_value {};
+  };
+
+  std::vector<Node> nodes_;
+  std::vector<DirectEntry> direct_;
+  size_t size_ {};
+
+  static unsigned bit( uint32_t address, uint8_t position ) { return ( address >> ( 31 - position ) ) & 1; }
+  uint32_t add_node( uint32_t prefix, uint8_t length );
+  void refresh_direct( uint32_t index );
+};
@@ -1,10 +1,18 @@
 #include "router.hh"
 
-#include <iostream>
+#include "log.hh"
+
 #include <limits>
 
 using namespace std;
 
+Router::Router( const ForwardingTable forwarding_table )
+{
+  if ( forwarding_table == ForwardingTable::Dir24_8 ) {
+    direct_table_ = make_unique<Dir24_8>();
+  }
+}
+
 // route_prefix: The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
 // prefix_length: For this route to be applicable, how many high-order (most-significant) bits of
 //    the route_prefix will need to match the corresponding bits of the datagram's destination address?
@@ -16,50 +24,36 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
+  if constexpr ( Log::enabled( LogLevel::Debug ) ) {
+    Log::debug( "adding route ", Address::from_ipv4_numeric( route_prefix ).ip(), "/", int { prefix_length },
+                " => ", next_hop.has_value() ? next_hop->ip() : "(direct)", " on interface ", interface_num );
+  }
 
   // 首先是否<route_prefix, prefix_length>已经存在route_table中
-  auto iter = router_table_.begin();
-  while (iter != router_table_.end()) {
-    if (iter->route_prefix == route_prefix && iter->prefix_length == prefix_length) {
-      iter->next_hop = next_hop;
-      iter->interface_num = interface_num;
-      break;
-    } else {
-      iter++;
-    }
+  const auto existing = prefixes_.find(route_prefix, prefix_length);
+  if (existing.has_value()) {
+    router_table_[*existing].next_hop = next_hop;
+    router_table_[*existing].interface_num = interface_num;
+    return;
   }
-  if (iter == router_table_.end()) {
-    router_table_.emplace_back(RouteEntry{route_prefix, prefix_length, next_hop, interface_num});
+  prefixes_.insert(route_prefix, prefix_length, static_cast<uint32_t>(router_table_.size()));
+  if (direct_table_) {
+    direct_table_->insert(route_prefix, prefix_length, static_cast<uint32_t>(router_table_.size()));
   }
+  router_table_.emplace_back(RouteEntry{route_prefix, prefix_length, next_hop, interface_num});
 }
 
-// 该函数寻找该ip地址最适配的<next_top, interface>
+// 该函数寻找该ip地址最适配的<next_top, interface>, 在前缀树里查找, 不再扫描整个路由表
 int Router::match(uint32_t target_ip_address) {
-
-  int index_matched = -1;
-  for (size_t index=0;index < router_table_.size();index++) {
-    if (static_cast<uint32_t>(32 - router_table_[index].prefix_length) == 32) {
-      index_matched = index;
-      continue;
-    }
-    auto mask = (0xFFFFFFFFU << static_cast<uint32_t>(32 - router_table_[index].prefix_length));
-    if ((router_table_[index].route_prefix & mask) == (target_ip_address & mask)) {
-      if (index_matched == -1 || router_table_[index_matched].prefix_length < router_table_[index].prefix_length) {
-        index_matched = index;
-      }
-    }
-  }
-  return index_matched;
+  const auto index = direct_table_ ? direct_table_->lookup(target_ip_address) : prefixes_.lookup(target_ip_address);
+  return index.has_value() ? static_cast<int>(*index) : -1;
 }
 
 void Router::route() {
   for (auto &&interface : interfaces_) {
     auto dgram = interface.maybe_receive();
     if (dgram.has_value()) {
-      std::cout << dgram->header.to_string() << std::endl;
+      Log::trace( "routing ", dgram->header );
       const uint32_t target_ip_address = dgram->header.dst;
       const int index = match(target_ip_address);
       if (index == -1) {
@@ -85,6 +79,8 @@ void Router::route() {
       }
     }
   }
+  // 路由器的主循环每一轮调用一次route(), 在这里把日志写出去
+  Log::flush();
 }
 
 
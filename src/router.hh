@@ -1,7 +1,10 @@
 #pragma once
 
+#include "dir_24_8.hh"
 #include "network_interface.hh"
+#include "prefix_trie.hh"
 
+#include <memory>
 #include <optional>
 #include <queue>
 
@@ -18,7 +21,7 @@ public:
   using NetworkInterface::NetworkInterface;
 
   // Construct from a NetworkInterface
-  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( interface ) {}
+  explicit AsyncNetworkInterface( NetworkInterface&& interface ) : NetworkInterface( std::move( interface ) ) {}
 
   // \brief Receives and Ethernet frame and responds appropriately.
 
@@ -63,6 +66,15 @@ class Router
   std::vector<AsyncNetworkInterface> interfaces_ {};
 
 public:
+  // How datagrams are matched against the routes
+  enum class ForwardingTable
+  {
+    PrefixTrie, // compressed trie: memory grows with the routes
+    Dir24_8,    // direct lookup in one or two memory accesses, for 64 MiB up front
+  };
+
+  explicit Router( ForwardingTable forwarding_table = ForwardingTable::PrefixTrie );
+
   // Add an interface to the router
   // interface: an already-constructed network interface
   // returns the index of the interface after it has been added to the router
@@ -86,10 +98,14 @@ public:
   // send it on one of interfaces to the correct next hop. The router
   // chooses the outbound interface and next-hop as specified by the
   // route with the longest prefix_length that matches the datagram's
-  // destination address.
+  // destination address. Then drain the log ring (Log::flush()).
   void route();
 private:
   int match(uint32_t target_ip_address);
 
   std::vector<RouteEntry> router_table_{};
+  // 前缀 -> router_table_中的下标, 用来做最长前缀匹配; 也用来找已经存在的路由
+  PrefixTrie prefixes_{};
+  // 选了DIR-24-8时, 转发用这个表查找 (和prefixes_一起增量更新)
+  std::unique_ptr<Dir24_8> direct_table_{};
 };
@@ -0,0 +1,87 @@
+#include "segment_coalescer.hh"
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+void SegmentCoalescer::push( TCPSegment segment )
+{
+  segments_in_++;
+  const TCPSenderMessage& message = segment.sender_message;
+  if ( pending_.has_value() ) {
+    TCPSenderMessage& merged = pending_->sender_message;
+    const bool contiguous = merged.seqno + merged.sequence_length() == message.seqno;
+    // ackno和窗口不同的segment不能合并, 否则TCPSender会漏掉中间的ACK
+    const bool same_ack = pending_->receiver_message.ackno == segment.receiver_message.ackno
+                          && pending_->receiver_message.window_size == segment.receiver_message.window_size;
+    const bool mergeable = contiguous && same_ack && !merged.FIN && !message.SYN && !segment.RST
+                           && !message.payload.empty()
+                           && merged.payload.size() + message.payload.size() <= max_payload_;
+    if ( mergeable ) {
+      if ( !pending_owned_ ) {
+        // payload可能和调用者共享(Buffer是shared_ptr), 第一次append之前先拷贝一份
+        string payload;
+        payload.reserve( merged.payload.size() + message.payload.size() );
+        payload.append( string_view( merged.payload ) );
+        merged.payload = move( payload );
+        pending_owned_ = true;
+      }
+      static_cast<string&>( merged.payload ).append( string_view( message.payload ) );
+      merged.FIN = message.FIN;
+      pending_->PSH |= segment.PSH;
+      if ( message.FIN ) {
+        flush();
+      }
+      return;
+    }
+    flush();
+  }
+
+  if ( segment.RST || ( message.payload.empty() && !message.SYN ) ) {
+    // RST和没有数据的segment不用合并, 直接交出去
+    ready_.push_back( move( segment ) );
+    segments_out_++;
+    return;
+  }
+  pending_ = move( segment );
+  pending_owned_ = false;
+  if ( pending_->sender_message.FIN ) {
+    flush();
+  }
+}
+
+void SegmentCoalescer::end_batch()
+{
+  flush();
+}
+
+optional<TCPSegment> SegmentCoalescer::pop()
+{
+  if ( ready_.empty() ) {
+    return {};
+  }
+  TCPSegment segment = move( ready_.front() );
+  ready_.pop_front();
+  return segment;
+}
+
+size_t SegmentCoalescer::drain( TCPPeer& peer )
+{
+  size_t count = 0;
+  while ( !ready_.empty() ) {
+    peer.receive( move( ready_.front() ) );
+    ready_.pop_front();
+    count++;
+  }
+  return count;
+}
+
+void SegmentCoalescer::flush()
+{
+  if ( pending_.has_value() ) {
+    ready_.push_back( move( pending_.value() ) );
+    pending_.reset();
+    segments_out_++;
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+/*
+ * Receive-side segment coalescing (a software version of GRO) in front of a TCPPeer.
+ *
+ * Segments of one flow are pushed in as they are read from the network. Consecutive in-order data
+ * segments that carry the same acknowledgment (ackno and window) are merged into one TCPSegment with
+ * a larger payload, so the Reassembler and the ByteStream see one insert per burst instead of one
+ * per MSS. A merged segment is completed (and becomes available from pop()) when:
+ *   - the next segment doesn't start where it ends (a gap, a retransmission or reordering),
+ *   - a flag changes (a SYN starts a new segment, a FIN ends one, an RST is never merged),
+ *   - the next segment acknowledges something else or changes the window,
+ *   - the next segment carries no payload (e.g. a pure ACK or a zero-window probe),
+ *   - merging would exceed the size limit, or
+ *   - the receive batch ends (end_batch()).
+ * Segments that can't be merged are passed through unchanged and in order.
+ */
+class SegmentCoalescer
+{
+public:
+  static constexpr uint64_t DEFAULT_MAX_PAYLOAD = 65536;
+
+  explicit SegmentCoalescer( uint64_t max_payload = DEFAULT_MAX_PAYLOAD ) : max_payload_( max_payload ) {}
+
+  /* Add a segment read from the network */
+  void push( TCPSegment segment );
+
+  /* The current receive batch is over: complete the segment being merged */
+  void end_batch();
+
+  /* Next completed segment, if any */
+  std::optional<TCPSegment> pop();
+
+  /* Hand all completed segments to a TCPPeer; returns how many there were */
+  size_t drain( TCPPeer& peer );
+
+  /* Statistics */
+  uint64_t segments_in() const { return segments_in_; }
+  uint64_t segments_out() const { return segments_out_; }
+
+private:
+  uint64_t max_payload_;
+  std::optional<TCPSegment> pending_ {}; // 正在合并的segment
+  bool pending_owned_ {};                // pending_的payload是否已经拷贝成自己的(可以append)
+  std::deque<TCPSegment> ready_ {};      // 合并完成, 等待交给TCPPeer的segment
+  uint64_t segments_in_ {};
+  uint64_t segments_out_ {};
+
+  void flush();
+};
@@ -0,0 +1,406 @@
+#include "tcp_demux.hh"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+void TCPDemultiplexer::listen( uint16_t port, const TCPConfig& config, size_t backlog )
+{
+  // 关闭了但是队列里还有连接的listener重新打开: 队列和计数都保留
+  auto [listener, inserted] = listeners_.try_emplace( port, Listener { config, backlog } );
+  if ( !inserted ) {
+    listener->second.config = config;
+    listener->second.backlog = backlog;
+    listener->second.open = true;
+  }
+}
+
+void TCPDemultiplexer::unlisten( uint16_t port )
+{
+  auto listener = listeners_.find( port );
+  if ( listener != listeners_.end() ) {
+    listener->second.open = false;
+    release_listener( port );
+  }
+}
+
+TCPDemultiplexer::ConnectionId TCPDemultiplexer::connect( const FlowKey& flow, const TCPConfig& config )
+{
+  const ConnectionId id = add_connection( flow, config );
+  connections_[id]->peer.connect();
+  mark_dirty( id );
+  schedule( id );
+  return id;
+}
+
+optional<TCPDemultiplexer::ConnectionId> TCPDemultiplexer::accept( uint16_t port )
+{
+  auto it = listeners_.find( port );
+  if ( it == listeners_.end() || it->second.accept_queue.empty() ) {
+    return {};
+  }
+  const ConnectionId id = it->second.accept_queue.front();
+  it->second.accept_queue.pop_front();
+  connections_[id]->queued.reset();
+  release_listener( port );
+  return id;
+}
+
+void TCPDemultiplexer::push( ConnectionId id )
+{
+  TCPPeer& peer = connection( id ).peer;
+  catch_up( id );
+  peer.push();
+  mark_dirty( id );
+  schedule( id );
+}
+
+void TCPDemultiplexer::receive( const InternetDatagram& datagram )
+{
+  if ( datagram.header.proto != IPv4Header::PROTO_TCP ) {
+    return;
+  }
+  TCPSegment segment;
+  Parser parser { datagram.payload };
+  segment.parse( parser, datagram.header.pseudo_checksum() );
+  if ( parser.has_error() ) {
+    return;
+  }
+
+  const FlowKey flow { datagram.header.dst, datagram.header.src, segment.dport, segment.sport };
+  const uint64_t flow_hash = hash( flow );
+  auto id = find( flow, flow_hash );
+
+  if ( !id.has_value() ) {
+    const bool syn = segment.sender_message.SYN && !segment.receiver_message.ackno.has_value() && !segment.RST;
+    auto listener = listeners_.find( flow.local_port );
+    if ( !syn || listener == listeners_.end() || !listener->second.open ) {
+      send_reset( flow, segment );
+      return;
+    }
+    if ( listener->second.syn_queue_length + listener->second.accept_queue.size() >= listener->second.backlog ) {
+      // 队列满了: 丢弃SYN, 对方会重传
+      syns_dropped_++;
+      return;
+    }
+    id = add_connection( flow, listener->second.config );
+    connections_[id.value()]->listener = flow.local_port;
+    listener->second.syn_queue_length++;
+  }
+
+  Connection& connection = *connections_[id.value()];
+  connection.coalescer.push( move( segment ) );
+  if ( !connection.coalescing ) {
+    connection.coalescing = true;
+    coalescing_.push_back( id.value() );
+  }
+  // 不能合并的segment马上交给peer, 正在合并的等这一批结束
+  deliver( id.value() );
+}
+
+void TCPDemultiplexer::end_batch()
+{
+  for ( const auto id : coalescing_ ) {
+    // 这一批里被释放的连接的id可能已经被重用了, 那也没关系: 新连接的segment同样要交出去
+    if ( connections_[id] ) {
+      connections_[id]->coalescing = false;
+      connections_[id]->coalescer.end_batch();
+      deliver( id );
+    }
+  }
+  coalescing_.clear();
+}
+
+void TCPDemultiplexer::tick( uint64_t ms_since_last_tick )
+{
+  end_batch();
+  // 只tick定时器到期的连接, 其他连接下次被访问的时候再追上时间
+  expired_.clear();
+  wheel_.tick( ms_since_last_tick, [this]( uint64_t key ) { expired_.push_back( static_cast<ConnectionId>( key ) ); } );
+  for ( const auto id : expired_ ) {
+    connections_[id]->deadline.reset();
+    catch_up( id );
+  }
+  // 先把剩下的segment(比如RST)取出来, 再释放已经关闭的连接
+  for ( const auto id : dirty_ ) {
+    collect( id );
+  }
+  dirty_.clear();
+  for ( const auto id : expired_ ) {
+    if ( !connections_[id]->peer.active() ) {
+      remove_connection( id );
+    } else {
+      schedule( id );
+    }
+  }
+}
+
+optional<InternetDatagram> TCPDemultiplexer::maybe_send()
+{
+  end_batch();
+  for ( const auto id : dirty_ ) {
+    collect( id );
+  }
+  dirty_.clear();
+  if ( outgoing_.empty() ) {
+    return {};
+  }
+  InternetDatagram datagram = move( outgoing_.front() );
+  outgoing_.pop_front();
+  return datagram;
+}
+
+TCPDemultiplexer::Connection& TCPDemultiplexer::connection( ConnectionId id ) const
+{
+  if ( not has_connection( id ) ) {
+    throw runtime_error( "TCPDemultiplexer: no connection " + to_string( id ) );
+  }
+  return *connections_[id];
+}
+
+// 64位的混合函数 (splitmix64的finalizer), seed可以防止对方故意制造冲突
+uint64_t TCPDemultiplexer::hash( const FlowKey& flow ) const
+{
+  uint64_t x = hash_seed_;
+  x ^= ( static_cast<uint64_t>( flow.local_address ) << 32 ) | flow.remote_address;
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+  x ^= ( static_cast<uint64_t>( flow.local_port ) << 16 ) | flow.remote_port;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+  return x ^ ( x >> 31 );
+}
+
+optional<TCPDemultiplexer::ConnectionId> TCPDemultiplexer::find( const FlowKey& flow, uint64_t flow_hash ) const
+{
+  if ( slots_.empty() ) {
+    return {};
+  }
+  const size_t mask = slots_.size() - 1;
+  for ( size_t i = flow_hash & mask;; i = ( i + 1 ) & mask ) {
+    const Slot& slot = slots_[i];
+    if ( slot.id == EMPTY ) {
+      return {};
+    }
+    if ( slot.hash == flow_hash && connections_[slot.id]->flow == flow ) {
+      return slot.id;
+    }
+  }
+}
+
+void TCPDemultiplexer::insert( ConnectionId id, uint64_t flow_hash )
+{
+  // 负载因子不超过1/2, 保证线性探测的长度很短
+  if ( ( connection_count_ + 1 ) * 2 > slots_.size() ) {
+    grow();
+  }
+  const size_t mask = slots_.size() - 1;
+  size_t i = flow_hash & mask;
+  while ( slots_[i].id != EMPTY ) {
+    i = ( i + 1 ) & mask;
+  }
+  slots_[i] = { flow_hash, id };
+  connection_count_++;
+}
+
+void TCPDemultiplexer::erase( const FlowKey& flow, uint64_t flow_hash )
+{
+  const size_t mask = slots_.size() - 1;
+  size_t i = flow_hash & mask;
+  while ( slots_[i].id != EMPTY ) {
+    if ( slots_[i].hash == flow_hash && connections_[slots_[i].id]->flow == flow ) {
+      break;
+    }
+    i = ( i + 1 ) & mask;
+  }
+  if ( slots_[i].id == EMPTY ) {
+    return;
+  }
+
+  // backward shift: 把后面的entry往前移, 填补删除留下的空位
+  size_t hole = i;
+  for ( size_t j = ( i + 1 ) & mask; slots_[j].id != EMPTY; j = ( j + 1 ) & mask ) {
+    const size_t home = slots_[j].hash & mask;
+    // j的entry可以移到hole, 当且仅当它的home不在(hole, j]之间
+    const bool movable = hole <= j ? ( home <= hole || home > j ) : ( home <= hole && home > j );
+    if ( movable ) {
+      slots_[hole] = slots_[j];
+      hole = j;
+    }
+  }
+  slots_[hole] = Slot {};
+  connection_count_--;
+}
+
+void TCPDemultiplexer::grow()
+{
+  vector<Slot> old = move( slots_ );
+  slots_.assign( old.empty() ? INITIAL_SLOTS : old.size() * 2, Slot {} );
+  const size_t mask = slots_.size() - 1;
+  for ( const auto& slot : old ) {
+    if ( slot.id == EMPTY ) {
+      continue;
+    }
+    // 用保存的hash重新放置, 不需要重新计算
+    size_t i = slot.hash & mask;
+    while ( slots_[i].id != EMPTY ) {
+      i = ( i + 1 ) & mask;
+    }
+    slots_[i] = slot;
+  }
+}
+
+TCPDemultiplexer::ConnectionId TCPDemultiplexer::add_connection( const FlowKey& flow, const TCPConfig& config )
+{
+  ConnectionId id {};
+  if ( !free_ids_.empty() ) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  } else {
+    id = connections_.size();
+    connections_.emplace_back();
+  }
+  connections_[id] = make_unique<Connection>( Connection { flow, TCPPeer { config } } );
+  connections_[id]->timer = wheel_.add_timer( id );
+  connections_[id]->clock = wheel_.now();
+  insert( id, hash( flow ) );
+  return id;
+}
+
+void TCPDemultiplexer::remove_connection( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  if ( connection.listener.has_value() ) {
+    listeners_.at( connection.listener.value() ).syn_queue_length--;
+    release_listener( connection.listener.value() );
+  }
+  if ( connection.queued.has_value() ) {
+    // 还没有被accept就关闭了(比如对方发了RST): 从accept队列里去掉, 这个id马上会被重用
+    std::erase( listeners_.at( connection.queued.value() ).accept_queue, id );
+    release_listener( connection.queued.value() );
+  }
+  erase( connection.flow, hash( connection.flow ) );
+  wheel_.remove_timer( connection.timer );
+  connections_[id].reset();
+  free_ids_.push_back( id );
+}
+
+void TCPDemultiplexer::mark_dirty( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  if ( !connection.dirty ) {
+    connection.dirty = true;
+    dirty_.push_back( id );
+  }
+}
+
+// 把peer的时间追到时间轮的时钟: 定时器没有到期的连接不会在tick()里被访问
+void TCPDemultiplexer::catch_up( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  if ( connection.clock < wheel_.now() ) {
+    connection.peer.tick( wheel_.now() - connection.clock );
+    connection.clock = wheel_.now();
+    mark_dirty( id );
+  }
+}
+
+// 按照peer下一次需要tick()的时间设置定时器; 已经关闭的连接马上到期, 在下一次tick()里释放
+void TCPDemultiplexer::schedule( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  const auto delay = connection.peer.active() ? connection.peer.time_until_tick() : optional<uint64_t> { 0 };
+  const auto deadline = delay.has_value() ? optional { wheel_.now() + delay.value() } : nullopt;
+  if ( deadline == connection.deadline ) {
+    return;
+  }
+  connection.deadline = deadline;
+  if ( deadline.has_value() ) {
+    wheel_.arm( connection.timer, deadline.value() );
+  } else {
+    wheel_.disarm( connection.timer );
+  }
+}
+
+void TCPDemultiplexer::deliver( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  catch_up( id );
+  if ( connection.coalescer.drain( connection.peer ) > 0 ) {
+    mark_dirty( id );
+    update_listener( id );
+  }
+  schedule( id );
+}
+
+// 握手完成的连接从SYN队列移到accept队列
+void TCPDemultiplexer::update_listener( ConnectionId id )
+{
+  Connection& connection = *connections_[id];
+  if ( !connection.listener.has_value() || connection.peer.state() == TCPPeer::State::SynReceived ) {
+    return;
+  }
+  const uint16_t port = connection.listener.value();
+  Listener& listener = listeners_.at( port );
+  connection.listener.reset();
+  listener.syn_queue_length--;
+  if ( connection.peer.active() ) {
+    listener.accept_queue.push_back( id );
+    connection.queued = port;
+  }
+  release_listener( port );
+}
+
+// 已经unlisten()的listener等队列里的连接都走了再删除, 免得重新listen()的时候计数对不上
+void TCPDemultiplexer::release_listener( uint16_t port )
+{
+  const auto listener = listeners_.find( port );
+  if ( !listener->second.open && listener->second.syn_queue_length == 0 && listener->second.accept_queue.empty() ) {
+    listeners_.erase( listener );
+  }
+}
+
+void TCPDemultiplexer::collect( ConnectionId id )
+{
+  if ( !connections_[id] ) {
+    return;
+  }
+  Connection& connection = *connections_[id];
+  connection.dirty = false;
+  for ( auto& segment : connection.peer.drain_outgoing() ) {
+    send_segment( connection.flow, segment );
+  }
+}
+
+void TCPDemultiplexer::send_segment( const FlowKey& flow, TCPSegment& segment )
+{
+  segment.sport = flow.local_port;
+  segment.dport = flow.remote_port;
+
+  InternetDatagram datagram;
+  datagram.header.src = flow.local_address;
+  datagram.header.dst = flow.remote_address;
+  datagram.header.len = IPv4Header::LENGTH + segment.header_length() + segment.sender_message.payload.size();
+  datagram.header.compute_checksum();
+  segment.compute_checksum( datagram.header.pseudo_checksum() );
+  datagram.payload = serialize( segment );
+  outgoing_.push_back( move( datagram ) );
+}
+
+// RFC 793: 不属于任何连接的segment用RST回复 (RST本身不回复)
+void TCPDemultiplexer::send_reset( const FlowKey& flow, const TCPSegment& segment )
+{
+  if ( segment.RST ) {
+    return;
+  }
+  TCPSegment reset;
+  reset.RST = true;
+  if ( segment.receiver_message.ackno.has_value() ) {
+    reset.sender_message.seqno = segment.receiver_message.ackno.value();
+  } else {
+    reset.sender_message.seqno = Wrap32 { 0 };
+    reset.receiver_message.ackno = segment.sender_message.seqno + segment.sender_message.sequence_length();
+  }
+  send_segment( flow, reset );
+  resets_sent_++;
+}
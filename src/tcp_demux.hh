@@ -0,0 +1,170 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+#include "segment_coalescer.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "timer_wheel.hh"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Dispatches incoming IPv4 datagrams (e.g. from an AsyncNetworkInterface or a Router) to the TCPPeer
+ * of their connection, and wraps the peers' outgoing segments back into datagrams.
+ *
+ * Connections are found by their 4-tuple in an open-addressing (linear probing) hash table. Each
+ * slot keeps the flow's precomputed hash next to the connection index, so a probe compares one
+ * integer before it touches the key, and growing the table never rehashes a key. Deletion shifts the
+ * following entries back instead of leaving tombstones, so lookups stay short under churn.
+ *
+ * A SYN to a port in the listen table creates a connection in the listener's SYN queue (bounded by
+ * its backlog); once the handshake completes, the connection moves to the accept queue. Segments
+ * for unknown flows are answered with an RST.
+ *
+ * Each connection's segments go through a SegmentCoalescer, so an in-order burst received in one
+ * batch reaches the TCPPeer as one segment. The segment being merged is delivered when the batch
+ * ends: at end_batch(), or at the latest by the next tick() or maybe_send().
+ *
+ * Each connection has a timer in a TimerWheel, armed for the next time its TCPPeer has work to do
+ * in tick() (TCPPeer::time_until_tick()). tick() only touches the connections whose timers fire;
+ * the others catch up on the elapsed time the next time a segment arrives for them or push() is
+ * called, so an idle connection costs nothing per tick.
+ */
+class TCPDemultiplexer
+{
+public:
+  using ConnectionId = uint32_t;
+
+  struct FlowKey
+  {
+    uint32_t local_address {};
+    uint32_t remote_address {};
+    uint16_t local_port {};
+    uint16_t remote_port {};
+
+    bool operator==( const FlowKey& other ) const = default;
+  };
+
+  explicit TCPDemultiplexer( uint64_t hash_seed = 0 ) : hash_seed_( hash_seed ) {}
+
+  /* Accept connections to `port` (on any local address) with the given config */
+  void listen( uint16_t port, const TCPConfig& config, size_t backlog = DEFAULT_BACKLOG );
+
+  /*
+   * Stop listening: later SYNs to the port are answered with an RST. Connections already accepted,
+   * queued or still in their handshake are unaffected, and queued ones can still be accept()ed.
+   */
+  void unlisten( uint16_t port );
+
+  /* Active open */
+  ConnectionId connect( const FlowKey& flow, const TCPConfig& config );
+
+  /* Next fully established connection on a listening port, if any */
+  std::optional<ConnectionId> accept( uint16_t port );
+
+  /* Process a datagram from the network */
+  void receive( const InternetDatagram& datagram );
+
+  /* The current batch of received datagrams is over: deliver the segments still being coalesced */
+  void end_batch();
+
+  /* Advance time, tick the connections whose timers fired, and release closed connections */
+  void tick( uint64_t ms_since_last_tick );
+
+  /* Outgoing datagrams */
+  std::optional<InternetDatagram> maybe_send();
+
+  /* The connection's TCPPeer (valid until the connection is closed and reaped by tick()) */
+  TCPPeer& peer( ConnectionId id ) { return connection( id ).peer; }
+  const TCPPeer& peer( ConnectionId id ) const { return connection( id ).peer; }
+  const FlowKey& flow( ConnectionId id ) const { return connection( id ).flow; }
+
+  /* Whether the connection still exists (it hasn't been reaped) */
+  bool has_connection( ConnectionId id ) const { return id < connections_.size() and connections_[id]; }
+
+  /*
+   * The application wrote to (or closed) the connection's outbound stream, read from its inbound one,
+   * or aborted the connection. Call it after any such change, so the connection's timer is re-armed.
+   */
+  void push( ConnectionId id );
+
+  /* Statistics */
+  size_t connection_count() const { return connection_count_; }
+  size_t table_capacity() const { return slots_.size(); }
+  uint64_t resets_sent() const { return resets_sent_; }
+  uint64_t syns_dropped() const { return syns_dropped_; }
+  size_t armed_timers() const { return wheel_.armed_count(); }
+
+  static constexpr size_t DEFAULT_BACKLOG = 128;
+
+private:
+  static constexpr size_t INITIAL_SLOTS = 64;
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Slot
+  {
+    uint64_t hash {};
+    ConnectionId id { EMPTY };
+  };
+
+  struct Connection
+  {
+    FlowKey flow;
+    TCPPeer peer;
+    std::optional<uint16_t> listener {}; // 在listener的SYN队列中(还没有完成握手)
+    std::optional<uint16_t> queued {};   // 在listener的accept队列中(还没有被accept)
+    bool dirty {};                       // 有segment等待发送
+    SegmentCoalescer coalescer {};
+    bool coalescing {}; // coalescer里有还没交给peer的segment
+    TimerWheel::TimerId timer {};
+    std::optional<uint64_t> deadline {}; // timer的到期时间(时间轮的时钟)
+    uint64_t clock {};                   // peer的时间已经追到了时间轮的这个时刻
+  };
+
+  struct Listener
+  {
+    TCPConfig config;
+    size_t backlog;
+    size_t syn_queue_length {};
+    std::deque<ConnectionId> accept_queue {};
+    bool open { true }; // unlisten()之后还要等队列里的连接走完
+  };
+
+  uint64_t hash_seed_;
+  std::vector<Slot> slots_ {};
+  size_t connection_count_ {};
+  std::vector<std::unique_ptr<Connection>> connections_ {}; // 用ConnectionId索引, 空的位置可以重用
+  std::vector<ConnectionId> free_ids_ {};
+  std::vector<ConnectionId> dirty_ {};
+  std::vector<ConnectionId> coalescing_ {};
+  TimerWheel wheel_ {};
+  std::vector<ConnectionId> expired_ {}; // 这次tick()中定时器到期的连接
+  std::unordered_map<uint16_t, Listener> listeners_ {};
+  std::deque<InternetDatagram> outgoing_ {};
+  uint64_t resets_sent_ {};
+  uint64_t syns_dropped_ {};
+
+  Connection& connection( ConnectionId id ) const;
+  uint64_t hash( const FlowKey& flow ) const;
+  std::optional<ConnectionId> find( const FlowKey& flow, uint64_t flow_hash ) const;
+  void insert( ConnectionId id, uint64_t flow_hash );
+  void erase( const FlowKey& flow, uint64_t flow_hash );
+  void grow();
+
+  ConnectionId add_connection( const FlowKey& flow, const TCPConfig& config );
+  void remove_connection( ConnectionId id );
+  void mark_dirty( ConnectionId id );
+  void catch_up( ConnectionId id );
+  void schedule( ConnectionId id );
+  void deliver( ConnectionId id );
+  void update_listener( ConnectionId id );
+  void release_listener( uint16_t port );
+  void collect( ConnectionId id );
+  void send_segment( const FlowKey& flow, TCPSegment& segment );
+  void send_reset( const FlowKey& flow, const TCPSegment& segment );
+};
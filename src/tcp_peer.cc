@@ -0,0 +1,271 @@
+#include "tcp_peer.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+TCPPeer::TCPPeer( const TCPConfig& config )
+  : config_( config )
+  , outbound_( config.send_capacity )
+  , inbound_( config.recv_capacity )
+  , sender_( config )
+  , receiver_( config )
+{}
+
+void TCPPeer::connect()
+{
+  if ( !active_ || sender_.syn_sent() ) {
+    return;
+  }
+  send_segments();
+}
+
+void TCPPeer::push()
+{
+  // 在LISTEN状态不能主动发送数据 (SYN要等对方的SYN到了才发送)
+  if ( !active_ || !sender_.syn_sent() ) {
+    return;
+  }
+  // 应用可能读走了数据: 调整接收缓冲区, 再把新的窗口带出去
+  receiver_.autotune( inbound_.writer() );
+  send_segments();
+  check_done();
+}
+
+void TCPPeer::receive( TCPSegment segment )
+{
+  if ( !active_ ) {
+    return;
+  }
+  time_since_last_segment_received_ = 0;
+
+  const TCPSenderMessage& message = segment.sender_message;
+  if ( segment.RST ) {
+    if ( rst_acceptable( segment ) ) {
+      set_error();
+    }
+    return;
+  }
+
+  if ( !sender_.syn_sent() ) {
+    // LISTEN: 只接受SYN; 带ACK的segment回复RST
+    if ( !message.SYN ) {
+      if ( segment.receiver_message.ackno.has_value() ) {
+        send_rst( segment.receiver_message.ackno.value() );
+      }
+      return;
+    }
+  }
+
+  receiver_.receive( move( segment.sender_message ), reassembler_, inbound_.writer() );
+  // SYN中的窗口不按照window scale放大 (RFC 7323), 所以先处理窗口, 再设置scale
+  sender_.receive( segment.receiver_message );
+  if ( receiver_.peer_window_scale().has_value() ) {
+    sender_.set_peer_window_scale( receiver_.peer_window_scale().value() );
+  }
+
+  // 对方先关闭了(passive close): 不需要在TIME_WAIT里等待
+  if ( inbound_.writer().is_closed() && !outbound_.reader().is_finished() ) {
+    linger_after_streams_finish_ = false;
+  }
+
+  send_segments();
+  send_ack_if_due();
+  check_done();
+}
+
+void TCPPeer::tick( uint64_t ms_since_last_tick )
+{
+  if ( !active_ ) {
+    return;
+  }
+  time_since_last_segment_received_ += ms_since_last_tick;
+  sender_.tick( ms_since_last_tick );
+  receiver_.tick( ms_since_last_tick );
+  receiver_.autotune( inbound_.writer() );
+
+  if ( sender_.consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS ) {
+    send_rst( sender_.send_empty_message().seqno );
+    set_error();
+    return;
+  }
+  if ( sender_.syn_sent() ) {
+    send_segments();
+  }
+  send_ack_if_due();
+  check_done();
+}
+
+optional<uint64_t> TCPPeer::time_until_tick() const
+{
+  if ( !active_ ) {
+    return {};
+  }
+  optional<uint64_t> delay = sender_.time_until_tick();
+  const auto consider = [&delay]( optional<uint64_t> other ) {
+    if ( other.has_value() && ( !delay.has_value() || other.value() < delay.value() ) ) {
+      delay = other;
+    }
+  };
+  consider( receiver_.time_until_ack( inbound_.writer() ) );
+  // TIME_WAIT: 见check_done()
+  const bool streams_done = inbound_.writer().is_closed() && sender_.fin_sent()
+                            && sender_.sequence_numbers_in_flight() == 0;
+  if ( streams_done && linger_after_streams_finish_ ) {
+    const uint64_t linger = 10 * static_cast<uint64_t>( config_.rt_timeout );
+    consider( linger - min( time_since_last_segment_received_, linger ) );
+  }
+  return delay;
+}
+
+void TCPPeer::abort()
+{
+  if ( !active_ ) {
+    return;
+  }
+  send_rst( sender_.send_empty_message().seqno );
+  set_error();
+}
+
+vector<TCPSegment>& TCPPeer::drain_outgoing()
+{
+  draining_.clear();
+  swap( draining_, outgoing_ );
+  return draining_;
+}
+
+TCPPeer::State TCPPeer::state() const
+{
+  const bool syn_received = receiver_.send( inbound_.writer() ).ackno.has_value();
+  const bool inbound_closed = inbound_.writer().is_closed();
+  const bool all_acked = sender_.sequence_numbers_in_flight() == 0;
+
+  if ( !active_ ) {
+    return State::Closed;
+  }
+  if ( !sender_.syn_sent() ) {
+    return State::Listen;
+  }
+  if ( !syn_received ) {
+    return State::SynSent;
+  }
+  if ( !sender_.syn_acked() ) {
+    return State::SynReceived;
+  }
+  if ( !sender_.fin_sent() ) {
+    return inbound_closed ? State::CloseWait : State::Established;
+  }
+  if ( !inbound_closed ) {
+    return all_acked ? State::FinWait2 : State::FinWait1;
+  }
+  if ( !linger_after_streams_finish_ ) {
+    return State::LastAck;
+  }
+  return all_acked ? State::TimeWait : State::Closing;
+}
+
+// RFC 5961: 只接受序号正好是期望值的RST, 防止盲目的RST攻击
+bool TCPPeer::rst_acceptable( const TCPSegment& segment ) const
+{
+  const auto ackno = receiver_.send( inbound_.writer() ).ackno;
+  if ( !ackno.has_value() ) {
+    // SYN_SENT: RST必须确认了我们的SYN
+    return sender_.syn_sent() && segment.receiver_message.ackno.has_value()
+           && segment.receiver_message.ackno.value() == sender_.send_empty_message().seqno;
+  }
+  return segment.sender_message.seqno == ackno.value();
+}
+
+void TCPPeer::send_segments()
+{
+  sender_.push( outbound_.reader() );
+  while ( auto message = sender_.maybe_send() ) {
+    TCPSegment& segment = next_outgoing();
+    const bool syn = message->SYN;
+    segment.sender_message = move( message.value() );
+    // 每个segment都带上最新的ackno和窗口
+    segment.receiver_message = receiver_.send( inbound_.writer() );
+    receiver_.ack_sent( inbound_.writer() );
+    if ( syn ) {
+      segment.mss = TCPConfig::MAX_PAYLOAD_SIZE;
+      // SYN中的窗口不缩放
+      segment.receiver_message.window_size = min<uint64_t>( inbound_.writer().available_capacity(), UINT16_MAX );
+    }
+  }
+}
+
+void TCPPeer::send_ack_if_due()
+{
+  if ( auto ack = receiver_.maybe_ack( inbound_.writer() ) ) {
+    if ( !ack->ackno.has_value() ) {
+      return;
+    }
+    TCPSegment& segment = next_outgoing();
+    segment.sender_message = sender_.send_empty_message();
+    segment.receiver_message = ack.value();
+  }
+}
+
+void TCPPeer::send_rst( Wrap32 seqno )
+{
+  TCPSegment& segment = next_outgoing();
+  segment.sender_message.seqno = seqno;
+  segment.RST = true;
+}
+
+void TCPPeer::set_error()
+{
+  outbound_.writer().set_error();
+  inbound_.writer().set_error();
+  active_ = false;
+}
+
+// 两个方向都结束了: 主动关闭的一方在TIME_WAIT里等待10倍的RTO, 被动关闭的一方直接结束
+void TCPPeer::check_done()
+{
+  const bool inbound_done = inbound_.writer().is_closed();
+  const bool outbound_done = sender_.fin_sent() && sender_.sequence_numbers_in_flight() == 0;
+  if ( !inbound_done || !outbound_done ) {
+    return;
+  }
+  if ( !linger_after_streams_finish_
+       || time_since_last_segment_received_ >= 10 * static_cast<uint64_t>( config_.rt_timeout ) ) {
+    active_ = false;
+  }
+}
+
+TCPSegment& TCPPeer::next_outgoing()
+{
+  TCPSegment& segment = outgoing_.emplace_back();
+  return segment;
+}
+
+string_view to_string( TCPPeer::State state )
+{
+  switch ( state ) {
+    case TCPPeer::State::Listen:
+      return "LISTEN";
+    case TCPPeer::State::SynSent:
+      return "SYN_SENT";
+    case TCPPeer::State::SynReceived:
+      return "SYN_RECEIVED";
+    case TCPPeer::State::Established:
+      return "ESTABLISHED";
+    case TCPPeer::State::CloseWait:
+      return "CLOSE_WAIT";
+    case TCPPeer::State::LastAck:
+      return "LAST_ACK";
+    case TCPPeer::State::FinWait1:
+      return "FIN_WAIT_1";
+    case TCPPeer::State::FinWait2:
+      return "FIN_WAIT_2";
+    case TCPPeer::State::Closing:
+      return "CLOSING";
+    case TCPPeer::State::TimeWait:
+      return "TIME_WAIT";
+    case TCPPeer::State::Closed:
+      return "CLOSED";
+  }
+  return "unknown";
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "byte_stream.hh"
+#include "reassembler.hh"
+#include "tcp_config.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/*
+ * A TCP connection endpoint: the TCPSender, the TCPReceiver, the Reassembler and both ByteStreams,
+ * plus the connection-level state machine that ties them together (handshake, RST, active and
+ * passive close, and lingering in TIME_WAIT).
+ *
+ * The owner feeds it segments from the network with receive(), advances time with tick(), and after
+ * either (or after the application writes to outbound_writer()) collects the segments to transmit
+ * with drain_outgoing(). Ports are left for the owner to fill in.
+ */
+class TCPPeer
+{
+public:
+  enum class State : uint8_t
+  {
+    Listen,
+    SynSent,
+    SynReceived,
+    Established,
+    CloseWait,
+    LastAck,
+    FinWait1,
+    FinWait2,
+    Closing,
+    TimeWait,
+    Closed,
+  };
+
+  explicit TCPPeer( const TCPConfig& config );
+
+  /* Active open: send a SYN */
+  void connect();
+
+  /* A segment arrived from the peer */
+  void receive( TCPSegment segment );
+
+  /* Time has passed by the given # of milliseconds since the last time tick() was called */
+  void tick( uint64_t ms_since_last_tick );
+
+  /*
+   * Milliseconds from now until tick() has work to do (a sender timer or paced segment, a delayed
+   * ACK, or the end of TIME_WAIT); empty if nothing is pending. Between those moments tick() may be
+   * called late, with the accumulated time, to the same effect.
+   */
+  std::optional<uint64_t> time_until_tick() const;
+
+  /* The application wrote to (or closed) the outbound stream, or read from the inbound one: send what
+   * the window allows, and the receive window the reads opened */
+  void push();
+
+  /* Abort the connection: send a RST and put both streams in the error state */
+  void abort();
+
+  /*
+   * Segments to transmit, oldest first. The returned vector belongs to the TCPPeer and is reused:
+   * it stays valid until the next call to drain_outgoing().
+   */
+  std::vector<TCPSegment>& drain_outgoing();
+
+  /* The application's ends of the two streams */
+  Writer& outbound_writer() { return outbound_.writer(); }
+  Reader& inbound_reader() { return inbound_.reader(); }
+  const Writer& outbound_writer() const { return outbound_.writer(); }
+  const Reader& inbound_reader() const { return inbound_.reader(); }
+
+  State state() const;
+  bool active() const { return active_; }
+
+  /* Accessors for use in testing */
+  const TCPSender& sender() const { return sender_; }
+  const TCPReceiver& receiver() const { return receiver_; }
+
+private:
+  TCPConfig config_;
+  ByteStream outbound_;
+  ByteStream inbound_;
+  Reassembler reassembler_ {};
+  TCPSender sender_;
+  TCPReceiver receiver_;
+
+  bool active_ { true };
+  bool linger_after_streams_finish_ { true }; // false once the peer has closed first (passive close)
+  uint64_t time_since_last_segment_received_ {};
+
+  // 发出去的segment: 两个vector轮流使用, 保留容量, 不用每次都重新分配
+  std::vector<TCPSegment> outgoing_ {};
+  std::vector<TCPSegment> draining_ {};
+
+  bool rst_acceptable( const TCPSegment& segment ) const;
+  void send_segments();
+  void send_ack_if_due();
+  void send_rst( Wrap32 seqno );
+  void set_error();
+  void check_done();
+  TCPSegment& next_outgoing();
+};
+
+std::string_view to_string( TCPPeer::State state );
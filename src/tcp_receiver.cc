@@ -1,8 +1,16 @@
 #include "tcp_receiver.hh"
+#include "tcp_config.hh"
 #include <iostream>
 
 using namespace std;
 
+TCPReceiver::TCPReceiver( const TCPConfig& config )
+  : window_scale_( config.window_scale )
+  , delayed_ack_ms_( config.delayed_ack_ms )
+  , max_capacity_( config.recv_capacity_max )
+  , sws_avoidance_( config.sws_avoidance )
+{}
+
 /**
  * 接受到来自peer的message,使用reassembler将message写入到
  */
@@ -14,21 +22,50 @@ void TCPReceiver::receive( TCPSenderMessage message, Reassembler& reassembler, W
     zero_point = message.seqno;
     message.seqno = message.seqno + 1;
     isSYN_ = true;
+    if (message.window_scale.has_value()) {
+      peer_window_scale_ = min(message.window_scale.value(), TCPConfig::MAX_WINDOW_SCALE);
+    }
   }
   if (!zero_point.has_value()) {
     //如果没有SYN,则直接返回
     return;
   }
+  const uint64_t expected_index = inbound_stream.bytes_pushed() + (isFIN_ && inbound_stream.is_closed());
+  const uint64_t payload_size = message.payload.size();
+  const uint64_t sequence_length = message.sequence_length();
+  const bool had_gap = reassembler.bytes_pending() > 0;
+  auto first_index_ = message.seqno.unwrap(zero_point.value(), expected_index) - 1;
   if (!message.payload.empty()) {
-    auto first_index_ = message.seqno.unwrap(zero_point.value(), inbound_stream.bytes_pushed()) - 1;
     reassembler.insert(first_index_, message.payload.release(), message.FIN, inbound_stream.writer());
   }
+
+  // 决定什么时候确认: 只包含ACK的空segment不需要确认
+  if (sequence_length > 0 || first_index_ != expected_index) {
+    if (!ack_pending_since_.has_value()) {
+      ack_pending_since_ = now_ms_;
+    }
+    if (message.SYN || message.FIN || first_index_ != expected_index || had_gap
+        || reassembler.bytes_pending() > 0) {
+      // 乱序, 重复或者填补空洞的数据(包括零窗口探测)要马上确认, 让对方尽快知道缺的是哪里
+      ack_now_ = true;
+    } else {
+      // 合并过的segment (见SegmentCoalescer) 按照其中完整segment的个数计算
+      unacked_segments_ += payload_size / TCPConfig::MAX_PAYLOAD_SIZE;
+    }
+    if (delayed_ack_ms_ == 0 || unacked_segments_ >= ACK_EVERY_SEGMENTS) {
+      ack_now_ = true;
+    }
+  }
   if (message.FIN) {
     isFIN_ = true;
     if (reassembler.bytes_pending() == 0) {
       inbound_stream.close();
     }
   }
+  if (max_capacity_ > 0 && payload_size > 0) {
+    sample_receive_rtt(inbound_stream);
+    autotune(inbound_stream);
+  }
 }
 
 /**
@@ -38,8 +75,8 @@ void TCPReceiver::receive( TCPSenderMessage message, Reassembler& reassembler, W
 TCPReceiverMessage TCPReceiver::send( const Writer& inbound_stream ) const
 {
   // Your code here.
-  (void)inbound_stream;
-  const uint16_t windowSize_ = inbound_stream.available_capacity() >= UINT16_MAX + 1?UINT16_MAX:inbound_stream.available_capacity();
+  // 协商了window scale的话, 窗口按照shift缩小之后再放进16位的字段 (向下取整, 不会多报)
+  const uint16_t windowSize_ = advertised_window(inbound_stream) >> window_scale();
   if (!zero_point.has_value()) {
     return {std::optional<Wrap32>{}, windowSize_};
   }
@@ -48,3 +85,161 @@ TCPReceiverMessage TCPReceiver::send( const Writer& inbound_stream ) const
   if (isFIN_ && inbound_stream.is_closed()) offset += 1;
   return {zero_point.value() + inbound_stream.bytes_pushed() + offset, windowSize_};
 }
+
+uint8_t TCPReceiver::window_scale() const
+{
+  // 双方的SYN都带了window scale才启用
+  if (window_scale_.has_value() && peer_window_scale_.has_value()) {
+    return min(window_scale_.value(), TCPConfig::MAX_WINDOW_SCALE);
+  }
+  return 0;
+}
+
+optional<uint8_t> TCPReceiver::peer_window_scale() const
+{
+  if (window_scale_.has_value() && peer_window_scale_.has_value()) {
+    return peer_window_scale_;
+  }
+  return {};
+}
+
+// 能够通告的窗口(字节): 受16位字段和window scale的限制
+uint64_t TCPReceiver::advertised_window( const Writer& inbound_stream ) const
+{
+  const uint64_t max_window = static_cast<uint64_t>(UINT16_MAX) << window_scale();
+  uint64_t window = inbound_stream.available_capacity();
+  if (sws_avoidance_) {
+    // 右边界 = capacity + 已读字节数按照step向下取整: 应用每读走一个step, 窗口才往前移动一个step
+    const uint64_t step = max<uint64_t>(min<uint64_t>(TCPConfig::MAX_PAYLOAD_SIZE, inbound_stream.capacity() / 2), 1);
+    const uint64_t held_back = inbound_stream.reader().bytes_popped() % step;
+    window = window > held_back ? window - held_back : 0;
+  }
+  return min(window, max_window) >> window_scale() << window_scale();
+}
+
+optional<uint64_t> TCPReceiver::ack_due( const Writer& inbound_stream ) const
+{
+  if (!zero_point.has_value()) {
+    return {};
+  }
+  if (ack_now_) {
+    return now_ms_;
+  }
+  if (last_window_.has_value()) {
+    // 窗口打开了(从0打开, 或者至少多了两个segment): 马上发送窗口更新
+    const uint64_t window = advertised_window(inbound_stream);
+    if ((last_window_.value() == 0 && window > 0)
+        || window >= last_window_.value() + ACK_EVERY_SEGMENTS * TCPConfig::MAX_PAYLOAD_SIZE) {
+      return now_ms_;
+    }
+  }
+  if (ack_pending_since_.has_value()) {
+    return ack_pending_since_.value() + delayed_ack_ms_;
+  }
+  return {};
+}
+
+optional<uint64_t> TCPReceiver::time_until_ack( const Writer& inbound_stream ) const
+{
+  const auto due = ack_due(inbound_stream);
+  if (!due.has_value()) {
+    return {};
+  }
+  return due.value() > now_ms_ ? due.value() - now_ms_ : 0;
+}
+
+optional<TCPReceiverMessage> TCPReceiver::maybe_ack( const Writer& inbound_stream )
+{
+  const auto due = ack_due(inbound_stream);
+  if (!due.has_value() || due.value() > now_ms_) {
+    return {};
+  }
+  ack_sent(inbound_stream);
+  return send(inbound_stream);
+}
+
+void TCPReceiver::ack_sent( const Writer& inbound_stream )
+{
+  unacked_segments_ = 0;
+  ack_pending_since_.reset();
+  ack_now_ = false;
+  last_window_ = advertised_window(inbound_stream);
+  window_edge_ = inbound_stream.bytes_pushed() + last_window_.value();
+}
+
+// 没有时间戳, 用"收到一整个窗口的数据需要多久"来估计RTT (比真实的RTT略大)
+void TCPReceiver::sample_receive_rtt( const Writer& inbound_stream )
+{
+  const uint64_t pushed = inbound_stream.bytes_pushed();
+  if (rtt_probe_edge_.has_value() && pushed >= rtt_probe_edge_.value()) {
+    const uint64_t sample = max<uint64_t>(now_ms_ - rtt_probe_start_, 1);
+    if (!rcv_rtt_ms_.has_value() || sample < rcv_rtt_ms_.value()) {
+      rcv_rtt_ms_ = sample;
+    } else {
+      rcv_rtt_ms_ = (7 * rcv_rtt_ms_.value() + sample) / 8;
+    }
+    rtt_probe_edge_.reset();
+  }
+  if (!rtt_probe_edge_.has_value()) {
+    // 右边界按照应用读完之后的窗口算, 否则刚收到的数据还没被读走, 测到的只是半个窗口
+    rtt_probe_edge_ = inbound_stream.reader().bytes_popped() + inbound_stream.capacity();
+    rtt_probe_start_ = now_ms_;
+  }
+}
+
+void TCPReceiver::autotune( Writer& inbound_stream )
+{
+  if (max_capacity_ == 0) {
+    return;
+  }
+  if (!base_capacity_.has_value()) {
+    base_capacity_ = inbound_stream.capacity();
+  }
+  const uint64_t popped = inbound_stream.reader().bytes_popped();
+  shrink(inbound_stream);
+  if (!rcv_rtt_ms_.has_value()) {
+    measure_start_ = now_ms_;
+    measure_popped_ = popped;
+    return;
+  }
+  const uint64_t elapsed = now_ms_ - measure_start_;
+  if (elapsed < rcv_rtt_ms_.value()) {
+    return;
+  }
+
+  // 每个RTT读走的字节数, 缓冲区要能容纳两倍, 这样应用读取的时候对方也不用停下来
+  const uint64_t drained = (popped - measure_popped_) * rcv_rtt_ms_.value() / elapsed;
+  const uint64_t capacity = inbound_stream.capacity();
+  if (2 * drained > capacity) {
+    inbound_stream.set_capacity(min(2 * drained, max(max_capacity_, capacity)));
+    shrink_target_.reset();
+    idle_rounds_ = 0;
+  } else if (popped == measure_popped_ && inbound_stream.reader().bytes_buffered() == 0) {
+    // 空闲: 慢慢把内存还回去, 但不小于原来的容量
+    idle_rounds_++;
+    if (idle_rounds_ >= AUTOTUNE_IDLE_ROUNDS) {
+      shrink_target_ = max(min(capacity, shrink_target_.value_or(capacity)) / 2, base_capacity_.value());
+      shrink(inbound_stream);
+      idle_rounds_ = 0;
+    }
+  } else {
+    idle_rounds_ = 0;
+  }
+  measure_start_ = now_ms_;
+  measure_popped_ = popped;
+}
+
+// 往shrink_target_缩小, 但是容量不能小于"通告过的右边界 - 已读字节数", 否则对方按照通告的窗口发来的数据会被丢掉
+void TCPReceiver::shrink( Writer& inbound_stream )
+{
+  if (!shrink_target_.has_value()) {
+    return;
+  }
+  const uint64_t popped = inbound_stream.reader().bytes_popped();
+  const uint64_t promised = window_edge_.value_or(0) > popped ? window_edge_.value() - popped : 0;
+  const uint64_t capacity = max(shrink_target_.value(), min(promised, inbound_stream.capacity()));
+  inbound_stream.set_capacity(capacity);
+  if (capacity == shrink_target_.value()) {
+    shrink_target_.reset();
+  }
+}
@@ -2,6 +2,7 @@
 
 #include "wrapping_integers.hh"
 #include "reassembler.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
@@ -11,7 +12,51 @@ private:
   std::optional<Wrap32> zero_point {};
   bool isSYN_ = false;
   bool isFIN_ = false;
+  std::optional<uint8_t> window_scale_ {};      // 自己在SYN中提供的window scale
+  std::optional<uint8_t> peer_window_scale_ {}; // 对方SYN中携带的window scale
+
+  // delayed ACK: 按序到达的数据每两个完整的segment确认一次, 否则最多等delayed_ack_ms_
+  static constexpr uint64_t ACK_EVERY_SEGMENTS = 2;
+  uint64_t delayed_ack_ms_ {0};                 // 0代表不延迟, 每个segment都马上确认
+  uint64_t now_ms_ {0};                         // receiver自己的时钟: 所有tick()的毫秒数之和
+  uint64_t unacked_segments_ {0};               // 上次ACK之后收到的完整segment数
+  std::optional<uint64_t> ack_pending_since_ {}; // 最早的一个还没有被确认的segment到达的时间
+  bool ack_now_ {false};                        // 乱序, SYN/FIN等需要马上确认的情况
+  std::optional<uint64_t> last_window_ {};      // 上一次ACK通告的窗口(字节)
+  std::optional<uint64_t> window_edge_ {};      // 上一次ACK通告的窗口右边界(stream index)
+
+  // 接收窗口自动调整: 按照应用每个RTT读走的字节数调整ByteStream的容量
+  static constexpr uint64_t AUTOTUNE_IDLE_ROUNDS = 4; // 连续这么多个RTT没有读取数据就缩小
+  uint64_t max_capacity_ {0};                   // 0代表不调整
+  std::optional<uint64_t> base_capacity_ {};    // ByteStream原来的容量, 缩小时的下限
+  std::optional<uint64_t> rcv_rtt_ms_ {};       // 收到一个窗口的数据所需要的时间, 作为RTT的估计
+  std::optional<uint64_t> rtt_probe_edge_ {};   // 测量RTT: 窗口右边界(stream index)
+  uint64_t rtt_probe_start_ {0};
+  uint64_t measure_start_ {0};                  // 本轮测量开始的时间
+  uint64_t measure_popped_ {0};                 // 本轮测量开始时应用已经读走的字节数
+  uint64_t idle_rounds_ {0};
+  std::optional<uint64_t> shrink_target_ {};    // 要缩小到的容量: 通告过的右边界被用掉之后才能缩到
+
+  bool sws_avoidance_ {false}; // 接收方的糊涂窗口综合症避免
+
+  /*
+   * With TCPConfig::sws_avoidance, the right edge of the advertised window only moves forward in
+   * steps of min(MSS, capacity/2) as the application pops bytes, so the peer is never offered a
+   * sliver of window that would tempt it to send a tiny segment.
+   */
+  uint64_t advertised_window( const Writer& inbound_stream ) const;
+  void sample_receive_rtt( const Writer& inbound_stream );
+  void shrink( Writer& inbound_stream );
 public:
+  /*
+   * `window_scale` is the shift this side offers on its own SYN (see TCPConfig::window_scale).
+   * Once the peer's SYN also carries the option, advertised windows are scaled by it.
+   */
+  explicit TCPReceiver( std::optional<uint8_t> window_scale = {} ) : window_scale_( window_scale ) {}
+
+  /* Construct a TCPReceiver from a TCPConfig (window scale and delayed-ACK settings) */
+  explicit TCPReceiver( const TCPConfig& config );
+
   /*
    * The TCPReceiver receives TCPSenderMessages, inserting their payload into the Reassembler
    * at the correct stream index.
@@ -20,4 +65,42 @@ public:
 
   /* The TCPReceiver sends TCPReceiverMessages back to the TCPSender. */
   TCPReceiverMessage send( const Writer& inbound_stream ) const;
+
+  /* Shift applied to the advertised window (0 unless both SYNs carried the window scale option) */
+  uint8_t window_scale() const;
+
+  /* The peer's window scale, if scaling was negotiated; the local TCPSender must apply it */
+  std::optional<uint8_t> peer_window_scale() const;
+
+  /*
+   * Delayed ACKs. In-order data is acknowledged every second full-sized segment, or once
+   * TCPConfig::delayed_ack_ms has passed since the first unacknowledged segment arrived. An ACK is
+   * due immediately for out-of-order or duplicate data, SYN, FIN, and when the window has opened by
+   * at least two segments (or from zero) since the last ACK.
+   *
+   * ack_due() is the time (on the receiver's clock, the sum of all tick() arguments) at which the owner
+   * should send an ACK, or empty if none is owed. maybe_ack() returns the ACK if it is due by now
+   * and resets the delayed-ACK state.
+   */
+  void tick( uint64_t ms_since_last_tick ) { now_ms_ += ms_since_last_tick; }
+  std::optional<uint64_t> ack_due( const Writer& inbound_stream ) const;
+  std::optional<uint64_t> time_until_ack( const Writer& inbound_stream ) const; // ack_due(), relative to now
+  std::optional<TCPReceiverMessage> maybe_ack( const Writer& inbound_stream );
+
+  /* An ACK went out piggybacked on a data segment: nothing is owed any more */
+  void ack_sent( const Writer& inbound_stream );
+
+  /*
+   * Receive-window auto-tuning (TCPConfig::recv_capacity_max). The receiver estimates the RTT as the
+   * time it takes to receive one window of data. Once per RTT it compares the bytes the application
+   * popped with the stream's capacity. It grows the capacity to twice the per-RTT drain (up to the
+   * cap), and after a few idle RTTs it halves it back toward the configured recv_capacity. A shrink
+   * never retracts the right edge of the last advertised window: the capacity only comes down as the
+   * application pops the bytes the peer was already allowed to send. receive() calls this; the owner
+   * should also call it after the application reads or time passes (TCPPeer does both).
+   */
+  void autotune( Writer& inbound_stream );
+
+  /* Receive-side RTT estimate used by auto-tuning, in ms (empty until measured) */
+  std::optional<uint64_t> receive_rtt() const { return rcv_rtt_ms_; }
 };
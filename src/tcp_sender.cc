@@ -1,6 +1,5 @@
 #include "tcp_sender.hh"
 #include "tcp_config.hh"
-#include <iostream>
 
 #include <random>
 
@@ -12,6 +11,21 @@ TCPSender::TCPSender( uint64_t initial_RTO_ms, optional<Wrap32> fixed_isn )
   initial_RTO_ms_( initial_RTO_ms )
 {}
 
+TCPSender::TCPSender( const TCPConfig& config )
+  : TCPSender( config.rt_timeout, config.fixed_isn )
+{
+  pacing_ = config.pacing;
+  pacing_rate_cfg_ = config.pacing_rate;
+  pacing_credit_ = pacing_burst();
+  rack_tlp_ = config.rack_tlp;
+  persist_ = config.persist_timer;
+  window_scale_offer_ = config.window_scale;
+  nagle_ = config.nagle;
+  if ( config.bbr ) {
+    bbr_.emplace( TCPConfig::MAX_PAYLOAD_SIZE );
+  }
+}
+
 uint64_t TCPSender::sequence_numbers_in_flight() const
 {
   // Your code here.
@@ -29,15 +43,52 @@ optional<TCPSenderMessage> TCPSender::maybe_send()
     if (messages_.empty()) {
         return {};
     }
+    refill_pacing();
+    const uint64_t rate = pacing_rate();
+    if (rate > 0 && pacing_credit_ < 0) {
+        // 令牌不足, 等tick()补充之后再发送
+        return {};
+    }
     TCPSenderMessage message;
     message = messages_.front();
     messages_.pop_front();
-    // 放入到已经发送但是没有ACK的数据报集合中
-    outstanding_messages_.push_back(message);
+    if (message.sequence_length() == 0) {
+        // 零窗口探测: 不占序号, 不需要确认, 也不启动重传定时器
+        return message;
+    }
+    if (rate > 0) {
+        pacing_credit_ -= static_cast<int64_t>(message.sequence_length() * 1000);
+    }
+    const uint64_t last_seqno = message.seqno.unwrap(isn_, next_seqno_) + message.sequence_length();
+    const bool new_data = last_seqno > highest_sent_;
+    if (!new_data) {
+        // 重传: 更新原来的记录, 而不是再放入一份
+        for (auto& segment : outstanding_messages_) {
+            if (segment.message.seqno == message.seqno) {
+                segment.sent_time = now();
+                segment.retransmitted = true;
+                segment.lost = false;
+                break;
+            }
+        }
+    } else {
+        highest_sent_ = last_seqno;
+        if (outstanding_messages_.empty()) {
+            // 之前没有数据在路上, 空闲的时间不能算进发送速率里
+            delivered_time_ = now();
+        }
+        // 放入到已经发送但是没有ACK的数据报集合中
+        outstanding_messages_.push_back({message, now(), delivered_, delivered_time_, false, false});
+    }
     if (!active_) {
         // 启动定时器
         active_ = true;
+        timer_start_ = now();
     }
+    if (new_data) {
+        arm_pto();
+    }
+    sync_timer();
     return message;
 }
 
@@ -47,13 +98,23 @@ void TCPSender::push( Reader& outbound_stream )
     if (fin_) {
         return;
     }
-    const uint64_t cur_window_size = window_size_==0?1:window_size_;
+    if (persist_ && syn_ && window_size_ == 0) {
+        // 窗口为0: 不发送数据 (SYN不受窗口限制, 所以只在SYN发出之后才检查), 在没有数据在路上的时候启动persist定时器去探测窗口
+        const bool waiting = outbound_stream.bytes_buffered() > 0 || outbound_stream.is_finished();
+        if (waiting && outstanding_messages_.empty() && messages_.empty() && !persist_deadline_.has_value()) {
+            persist_deadline_ = now() + persist_interval_;
+            sync_timer();
+        }
+        return;
+    }
+    const uint64_t cur_window_size = send_window();
     while (cur_window_size > sequence_numbers_in_flight()) {
         // 首先要保证窗口有还有空余位置去发送
         TCPSenderMessage message;
         if (!syn_) {
             syn_ = true;
             message.SYN = true;
+            message.window_scale = window_scale_offer_;
         }
 
         message.seqno = isn_ + next_seqno_;
@@ -62,6 +123,12 @@ void TCPSender::push( Reader& outbound_stream )
                            static_cast<size_t >(outbound_stream.bytes_buffered())), cur_window_size-sequence_numbers_in_flight());
 
 
+        if (nagle_ && !no_delay_ && !message.SYN && len < TCPConfig::MAX_PAYLOAD_SIZE
+            && sequence_numbers_in_flight() > 0 && !outbound_stream.writer().is_closed()) {
+            // Nagle: 小的segment等前面的数据被确认之后再发送, 这样期间写入的数据可以合并
+            break;
+        }
+
         read(outbound_stream, len, message.payload);
 
         if (!fin_ && outbound_stream.is_finished() &&
@@ -94,12 +161,18 @@ TCPSenderMessage TCPSender::send_empty_message() const
     return message;
 }
 
+void TCPSender::set_peer_window_scale( uint8_t shift )
+{
+    peer_window_scale_ = min(shift, TCPConfig::MAX_WINDOW_SCALE);
+}
+
 /**
  * 这个函数主要是浏览sender已经发送的但是没有acknowledge的segment的集合，
  * 将那些已经被sender acknowledge的从集合中删除
  */
 void TCPSender::receive( const TCPReceiverMessage& msg )
 {
+    const uint64_t prior_ackno = recev_seqno_;
     if (msg.ackno.has_value()) {
         auto rv_seqno = msg.ackno->unwrap(isn_, next_seqno_);
         if (rv_seqno > next_seqno_ || rv_seqno < recev_seqno_) {
@@ -110,16 +183,36 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
         recev_seqno_ = msg.ackno->unwrap(isn_, next_seqno_);
     }
 
-    window_size_ = msg.window_size;
+    // 重复ACK: 没有确认新的数据, 窗口也没变, 说明对方收到了队头之后的segment
+    const uint64_t window_size = static_cast<uint64_t>(msg.window_size) << peer_window_scale_;
+    const bool duplicate_ack = msg.ackno.has_value() && recev_seqno_ == prior_ackno
+                               && window_size == window_size_ && !outstanding_messages_.empty();
 
+    // 窗口和RTT变化之前, 先按照旧的速率补充令牌
+    refill_pacing();
+    window_size_ = window_size;
+    if (window_size_ != 0) {
+        // 窗口打开了, 结束persist
+        persist_deadline_.reset();
+        persist_interval_ = initial_RTO_ms_;
+        zero_window_probes_ = 0;
+    }
+
+    // 最新被确认的segment, 用它来得到RTT和发送速率的样本
+    optional<OutstandingSegment> newest_acked;
+    uint64_t newly_acked = 0;
     while (!outstanding_messages_.empty()) {
-        auto segment = outstanding_messages_.front();
-        auto last_seqno = (segment.seqno + segment.sequence_length()).unwrap(isn_, next_seqno_);
+        auto& segment = outstanding_messages_.front();
+        auto last_seqno = (segment.message.seqno + segment.message.sequence_length()).unwrap(isn_, next_seqno_);
         if (last_seqno <= recev_seqno_) {
+            delivered_ += segment.message.sequence_length();
+            newly_acked += segment.message.sequence_length();
+            delivered_time_ = now();
+            newest_acked = std::move(segment);
             outstanding_messages_.pop_front();
             // 如果sender收到的有效的ackno，则需要你重置定时器
             if (window_size_ != 0){
-                timestamp_ = 0;
+                timer_start_ = now();
                 cur_RTO_ = initial_RTO_ms_;
                 ncr_ = 0;
             }
@@ -128,25 +221,307 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
         }
     }
 
+    if (newest_acked.has_value()) {
+        BBR::RateSample sample;
+        sample.prior_delivered = newest_acked->delivered;
+        sample.delivered = delivered_;
+        sample.newly_acked = newly_acked;
+        sample.delivery_rate = (delivered_ - newest_acked->delivered) * 1000
+                               / max<uint64_t>(now() - newest_acked->delivered_time, 1);
+        sample.has_rate = true;
+        if (!newest_acked->retransmitted) {
+            sample.rtt_ms = now() - newest_acked->sent_time;
+            sample.has_rtt = true;
+            take_rtt_sample(sample.rtt_ms);
+        }
+        if (bbr_.has_value()) {
+            const uint64_t in_flight = highest_sent_ > recev_seqno_ ? highest_sent_ - recev_seqno_ : 0;
+            bbr_->on_ack(now(), sample, in_flight);
+        }
+    }
+
+    if (rack_tlp_) {
+        if (tlp_end_seqno_.has_value() && recev_seqno_ >= tlp_end_seqno_.value()) {
+            tlp_end_seqno_.reset();
+        }
+        if (newest_acked.has_value()) {
+            rack_deadline_.reset();
+            pto_deadline_.reset();
+            arm_pto();
+        }
+        if (duplicate_ack) {
+            rack_detect_loss();
+        }
+    }
+
     // 如果已发送但未认可的segment没有了，就关闭定时器
     active_ = !outstanding_messages_.empty();
+    sync_timer();
 
 }
 
 void TCPSender::tick( const size_t ms_since_last_tick )
 {
   // Your code here.
-    if (active_) {
-        timestamp_ += ms_since_last_tick;
-        if (timestamp_ >= cur_RTO_ && !outstanding_messages_.empty()) {
-            // 定时器已经失效，所以需要重新传递最久的数据报
-            messages_.push_back(outstanding_messages_.front());
-            if (window_size_ > 0) {
-                ncr_ += 1;
-                cur_RTO_ = pow(2, ncr_) * initial_RTO_ms_;
-            }
-            timestamp_ = 0;
+    now_ms_ += ms_since_last_tick;
+    refill_pacing();
+    check_timer();
+    sync_timer();
+}
+
+void TCPSender::check_timer()
+{
+    if (rack_deadline_.has_value() && now() >= rack_deadline_.value()) {
+        rack_deadline_.reset();
+        rack_detect_loss();
+    }
+    if (pto_deadline_.has_value() && now() >= pto_deadline_.value()) {
+        send_tail_loss_probe();
+    }
+    if (persist_deadline_.has_value() && now() >= persist_deadline_.value()) {
+        send_zero_window_probe();
+    }
+    if (active_ && !outstanding_messages_.empty() && now() >= timer_start_ + cur_RTO_) {
+        // 定时器已经失效，所以需要重新传递最久的数据报
+        messages_.push_back(outstanding_messages_.front().message);
+        // 开启persist的时候, 窗口为0的重传也要退避
+        if (window_size_ > 0 || persist_) {
+            ncr_ += 1;
+            cur_RTO_ = pow(2, ncr_) * initial_RTO_ms_;
         }
+        timer_start_ = now();
+        // 超时之后结束tail loss probe和RACK的状态
+        pto_deadline_.reset();
+        tlp_end_seqno_.reset();
+        rack_deadline_.reset();
+    }
+}
+
+/**
+ * Tail loss probe的超时时间是 2*SRTT (只有一个segment在路上时再加上对方delayed ACK的时间),
+ * 但不能晚于重传定时器. 一次probe被确认之前不会再发送新的probe.
+ */
+void TCPSender::arm_pto()
+{
+    if (!rack_tlp_ || !srtt_ms_.has_value() || tlp_end_seqno_.has_value() || outstanding_messages_.empty()) {
+        return;
+    }
+    uint64_t pto = 2 * srtt_ms_.value();
+    if (outstanding_messages_.size() == 1) {
+        pto += TLP_DELAYED_ACK_MS;
+    }
+    pto_deadline_ = min(now() + max<uint64_t>(pto, 1), timer_start_ + cur_RTO_);
+}
+
+// 一直没有收到ACK: 重传最后一个segment, 让对方的ACK尽快暴露出丢失 (不计入连续重传次数)
+void TCPSender::send_tail_loss_probe()
+{
+    pto_deadline_.reset();
+    if (outstanding_messages_.empty()) {
+        return;
+    }
+    messages_.push_back(outstanding_messages_.back().message);
+    tlp_end_seqno_ = highest_sent_;
+    timer_start_ = now();
+}
+
+/**
+ * 零窗口探测: 发送一个序号为 ackno-1 的空报文 (对方已经确认过的序号), 对方会回复一个带有当前窗口的ACK.
+ * 探测不放进重传队列, 探测间隔指数退避, 最长为 MAX_PERSIST_MS.
+ */
+void TCPSender::send_zero_window_probe()
+{
+    TCPSenderMessage probe;
+    probe.seqno = isn_ + (recev_seqno_ - 1);
+    messages_.push_back(probe);
+    zero_window_probes_++;
+    persist_interval_ = min(persist_interval_ * 2, MAX_PERSIST_MS);
+    persist_deadline_ = now() + persist_interval_;
+}
+
+/**
+ * RACK: 用发送时间而不是重复ACK的个数来判断丢失.
+ * 重复ACK说明队头之后发送的segment已经到达, 如果队头发送之后又过了 SRTT + reorder window
+ * 还没有被确认, 就认为它丢失了并立即重传; 否则等到那个时间再判断.
+ */
+void TCPSender::rack_detect_loss()
+{
+    if (outstanding_messages_.empty() || !srtt_ms_.has_value()) {
+        return;
+    }
+    auto& head = outstanding_messages_.front();
+    if (head.lost || head.retransmitted) {
+        // 没有SACK的时候分不清重复ACK是不是由重传之后发送的segment触发的, 重传丢失交给重传定时器处理
+        return;
+    }
+    const uint64_t srtt = srtt_ms_.value();
+    const uint64_t lost_at = head.sent_time + srtt + max<uint64_t>(srtt / 4, 1);
+    if (now() < lost_at) {
+        rack_deadline_ = lost_at;
+        return;
     }
+    head.lost = true;
+    messages_.push_back(head.message);
+    rack_deadline_.reset();
+    pto_deadline_.reset();
 }
 
+uint64_t TCPSender::now() const
+{
+    if (wheel_timer_.has_value()) {
+        return now_ms_ + wheel_timer_->wheel->now() - wheel_timer_->base;
+    }
+    return now_ms_;
+}
+
+void TCPSender::attach_timer_wheel( TimerWheel& wheel, uint64_t key )
+{
+    detach_timer_wheel();
+    wheel_timer_ = WheelTimer{&wheel, wheel.add_timer(key), wheel.now()};
+    sync_timer();
+}
+
+void TCPSender::detach_timer_wheel()
+{
+    if (!wheel_timer_.has_value()) {
+        return;
+    }
+    // 把时间轮上走过的时间并入自己的时钟
+    now_ms_ = now();
+    wheel_timer_->wheel->remove_timer(wheel_timer_->id);
+    wheel_timer_.reset();
+}
+
+// 最早的定时器: 重传, tail loss probe 和 RACK
+optional<uint64_t> TCPSender::timer_deadline() const
+{
+    optional<uint64_t> deadline;
+    if (active_ && !outstanding_messages_.empty()) {
+        deadline = timer_start_ + cur_RTO_;
+    }
+    for (const auto& other : {pto_deadline_, rack_deadline_, persist_deadline_}) {
+        if (other.has_value() && (!deadline.has_value() || other.value() < deadline.value())) {
+            deadline = other;
+        }
+    }
+    return deadline;
+}
+
+// 把重传定时器的deadline同步到时间轮上 (只有deadline变化的时候才需要重新设置)
+void TCPSender::sync_timer()
+{
+    if (!wheel_timer_.has_value()) {
+        return;
+    }
+    optional<uint64_t> deadline;
+    const auto expire_at = timer_deadline();
+    if (expire_at.has_value()) {
+        // 换算成时间轮的时钟
+        deadline = wheel_timer_->wheel->now() + (expire_at.value() > now() ? expire_at.value() - now() : 0);
+    }
+    if (deadline == wheel_timer_->deadline) {
+        return;
+    }
+    wheel_timer_->deadline = deadline;
+    if (deadline.has_value()) {
+        wheel_timer_->wheel->arm(wheel_timer_->id, deadline.value());
+    } else {
+        wheel_timer_->wheel->disarm(wheel_timer_->id);
+    }
+}
+
+optional<uint64_t> TCPSender::next_send_time() const
+{
+    if (messages_.empty()) {
+        return {};
+    }
+    const uint64_t rate = pacing_rate();
+    const int64_t credit = pacing_credit();
+    if (rate == 0 || credit >= 0) {
+        return now();
+    }
+    // 欠下的令牌需要多少毫秒才能补齐 (向上取整)
+    const auto deficit = static_cast<uint64_t>(-credit);
+    return now() + (deficit + rate - 1) / rate;
+}
+
+optional<uint64_t> TCPSender::time_until_tick() const
+{
+    optional<uint64_t> at = timer_deadline();
+    const auto send_at = next_send_time();
+    if (send_at.has_value() && (!at.has_value() || send_at.value() < at.value())) {
+        at = send_at;
+    }
+    if (!at.has_value()) {
+        return {};
+    }
+    return at.value() > now() ? at.value() - now() : 0;
+}
+
+/**
+ * 发送速率: 如果配置了固定速率就用配置的速率, 否则用 1.25 * window / SRTT.
+ * 在得到第一个RTT样本之前不做限速.
+ */
+uint64_t TCPSender::pacing_rate() const
+{
+    if (bbr_.has_value()) {
+        // BBR总是按照估计出来的瓶颈带宽发送
+        return bbr_->pacing_rate();
+    }
+    if (!pacing_) {
+        return 0;
+    }
+    if (pacing_rate_cfg_ > 0) {
+        return pacing_rate_cfg_;
+    }
+    if (!srtt_ms_.has_value()) {
+        return 0;
+    }
+    const uint64_t window = max<uint64_t>(window_size_, 1);
+    return max<uint64_t>(window * 1250 / max<uint64_t>(srtt_ms_.value(), 1), 1);
+}
+
+int64_t TCPSender::pacing_burst() const
+{
+    return static_cast<int64_t>(TCPConfig::PACING_BURST * 1000);
+}
+
+// 令牌按照时间惰性补充: 当前的令牌 = 上次的令牌 + 速率 * 经过的时间 (不超过桶的大小)
+int64_t TCPSender::pacing_credit() const
+{
+    const uint64_t rate = pacing_rate();
+    if (rate == 0) {
+        return pacing_credit_;
+    }
+    return min(pacing_credit_ + static_cast<int64_t>(rate * (now() - pacing_stamp_)), pacing_burst());
+}
+
+void TCPSender::refill_pacing()
+{
+    pacing_credit_ = pacing_credit();
+    pacing_stamp_ = now();
+}
+
+// 可以发送的窗口: receiver的窗口 (窗口为0时当作1), 使用BBR时还要受拥塞窗口的限制
+uint64_t TCPSender::send_window() const
+{
+    const uint64_t window = window_size_ == 0 ? 1 : window_size_;
+    if (bbr_.has_value()) {
+        return min(window, bbr_->cwnd());
+    }
+    return window;
+}
+
+// RFC 6298 的平滑RTT估计
+void TCPSender::take_rtt_sample( uint64_t sample_ms )
+{
+    if (!srtt_ms_.has_value()) {
+        srtt_ms_ = sample_ms;
+        rttvar_ms_ = sample_ms / 2;
+        return;
+    }
+    const uint64_t srtt = srtt_ms_.value();
+    const uint64_t delta = srtt > sample_ms ? srtt - sample_ms : sample_ms - srtt;
+    rttvar_ms_ = (3 * rttvar_ms_ + delta) / 4;
+    srtt_ms_ = (7 * srtt + sample_ms) / 8;
+}
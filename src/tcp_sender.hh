@@ -1,8 +1,11 @@
 #pragma once
 
+#include "bbr.hh"
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
+#include "timer_wheel.hh"
 
 #include <exception>
 #include <functional>
@@ -27,20 +30,98 @@ private:
   bool fin_ = false;
   uint64_t next_seqno_{0};   // 记录sender已经发送多少个字节（包含第一次握手）
   uint64_t recev_seqno_{0};  // 记录sender已经接受了多少个字节）
-  uint16_t window_size_{1};  // receiver的滑动窗口的大小
-  std::deque<TCPSenderMessage> outstanding_messages_{}; // sender已经发送，但是还没有收到receiver回复的ack
+  uint64_t window_size_{1};  // receiver的滑动窗口的大小 (已经按照window scale放大)
+  std::optional<uint8_t> window_scale_offer_{}; // SYN中提供的window scale (本地receiver的shift)
+  uint8_t peer_window_scale_{0};                // 对方receiver的shift, 协商成功之后由set_peer_window_scale()设置
+  // 已经发送但还没有被确认的segment, 以及发送时的记录(用于RTT和发送速率的估计)
+  struct OutstandingSegment
+  {
+    TCPSenderMessage message;
+    uint64_t sent_time;      // (最近一次)发送的时间
+    uint64_t delivered;      // 发送时已经被确认的总字节数
+    uint64_t delivered_time; // 发送时最近一次确认的时间
+    bool retransmitted;      // 是否被重传过 (重传过的不用来测量RTT)
+    bool lost;               // 被RACK判定为丢失, 正在等待重传
+  };
+  std::deque<OutstandingSegment> outstanding_messages_{}; // sender已经发送，但是还没有收到receiver回复的ack
   std::deque<TCPSenderMessage> messages_{}; // Sender 准备发送的sender messages
   uint64_t ncr_{0}; // the number of consecutive retransmissions
 
   // 定时器
-  size_t timestamp_{0}; // 只从上次调用已经过了多久了
+  uint64_t timer_start_{0}; // 定时器(重新)启动的时间
   bool active_{false};
   uint64_t cur_RTO_{initial_RTO_ms_};
 
+  // sender自己的时钟: 所有tick()的毫秒数之和
+  uint64_t now_ms_{0};
+
+  // 可选的共享时间轮: 挂上之后时钟和重传定时器都由它来驱动
+  struct WheelTimer
+  {
+    TimerWheel* wheel;
+    TimerWheel::TimerId id;
+    uint64_t base;                         // 挂上时时间轮的时钟
+    std::optional<uint64_t> deadline {};   // 当前在时间轮上设置的deadline
+  };
+  std::optional<WheelTimer> wheel_timer_{};
+
+  // RTT测量 (重传的segment不参与测量)
+  uint64_t highest_sent_{0}; // 已经发送过的最大序号(absolute), 用来区分新数据和重传
+  std::optional<uint64_t> srtt_ms_{};
+  uint64_t rttvar_ms_{0};
+
+  // 发送速率估计: 到目前为止被确认的总字节数, 以及最近一次确认的时间
+  uint64_t delivered_{0};
+  uint64_t delivered_time_{0};
+
+  // 可选的BBR拥塞控制
+  std::optional<BBR> bbr_{};
+
+  // 可选的RACK-TLP
+  static constexpr uint64_t TLP_DELAYED_ACK_MS = 200; // 只有一个segment在路上时, 要多等对方的delayed ACK
+  bool rack_tlp_{false};
+  std::optional<uint64_t> pto_deadline_{};  // tail loss probe 的时间
+  std::optional<uint64_t> tlp_end_seqno_{}; // 正在进行的probe覆盖到的序号, 确认之前不再发送新的probe
+  std::optional<uint64_t> rack_deadline_{}; // 收到重复ACK之后, 队头segment被判定为丢失的时间
+
+  // 可选的persist定时器: 窗口为0时不往窗口里塞数据, 而是定时发送不占序号的探测报文
+  static constexpr uint64_t MAX_PERSIST_MS = 60000; // 探测间隔的上限
+  bool persist_{false};
+  std::optional<uint64_t> persist_deadline_{};
+  uint64_t persist_interval_{initial_RTO_ms_};
+  uint64_t zero_window_probes_{0};
+
+  // Nagle: 有数据没被确认时, 不发送小于MSS的segment (no_delay_可以关掉)
+  bool nagle_{false};
+  bool no_delay_{false};
+
+  // 发送节奏控制 (token bucket)
+  bool pacing_{false};
+  uint64_t pacing_rate_cfg_{0}; // 配置的速率 bytes/s, 0代表用窗口/SRTT推导
+  int64_t pacing_credit_{0};    // 令牌, 单位是 byte*ms/s (即 bytes/1000), 可以为负(欠账)
+  uint64_t pacing_stamp_{0};    // 上一次补充令牌的时间
+
+  uint64_t now() const;
+  void check_timer();
+  void sync_timer();
+  std::optional<uint64_t> timer_deadline() const;
+  void arm_pto();
+  void send_tail_loss_probe();
+  void rack_detect_loss();
+  void send_zero_window_probe();
+  void take_rtt_sample( uint64_t sample_ms );
+  int64_t pacing_burst() const;
+  int64_t pacing_credit() const;
+  void refill_pacing();
+  uint64_t send_window() const;
+
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
   TCPSender( uint64_t initial_RTO_ms, std::optional<Wrap32> fixed_isn );
 
+  /* Construct TCP sender from a TCPConfig (RTO, ISN and the optional pacing settings) */
+  explicit TCPSender( const TCPConfig& config );
+
   /* Push bytes from the outbound stream */
   void push( Reader& outbound_stream );
 
@@ -53,11 +134,60 @@ public:
   /* Receive an act on a TCPReceiverMessage from the peer's receiver */
   void receive( const TCPReceiverMessage& msg );
 
+  /*
+   * Window scaling was negotiated (see TCPReceiver::peer_window_scale()): from now on, windows in
+   * TCPReceiverMessages from the peer are shifted left by `shift`.
+   */
+  void set_peer_window_scale( uint8_t shift );
+
+  /* Per-connection override of TCPConfig::nagle (like TCP_NODELAY): send small segments immediately */
+  void set_no_delay( bool no_delay ) { no_delay_ = no_delay; }
+
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called. */
   void tick( uint64_t ms_since_last_tick );
 
+  /*
+   * Let a shared TimerWheel drive this sender's clock and retransmission timer. The sender registers
+   * its RTO deadline under `key`; instead of calling tick() on every sender, the owner advances the
+   * wheel and calls timer_expired() on the sender whose key the wheel reports.
+   */
+  void attach_timer_wheel( TimerWheel& wheel, uint64_t key );
+  void detach_timer_wheel();
+
+  /* The retransmission deadline registered with the TimerWheel has passed */
+  void timer_expired() { tick( 0 ); }
+
+  /*
+   * Earliest time (in ms on the sender's clock, i.e. the sum of all tick() arguments, plus the time that
+   * has passed on an attached TimerWheel) at which maybe_send()
+   * will release the next queued segment. Empty if nothing is waiting to be sent. With pacing disabled this
+   * is always "now" whenever a segment is queued, so an event loop can sleep until this moment precisely.
+   */
+  std::optional<uint64_t> next_send_time() const;
+
+  /*
+   * Milliseconds from now until tick() has work to do: a retransmission, tail-loss-probe, RACK or
+   * persist timer expires, or a paced segment may be released. Empty if nothing is pending, so an
+   * owner with many senders only needs to tick the ones whose time has come.
+   */
+  std::optional<uint64_t> time_until_tick() const;
+
+  /* Current pacing rate in bytes/s (0 if segments are not being paced) */
+  uint64_t pacing_rate() const;
+
+  /* Smoothed round-trip time estimate in ms (empty until the first RTT sample) */
+  std::optional<uint64_t> smoothed_rtt() const { return srtt_ms_; }
+
+  /* The BBR model, if the sender was configured to use it */
+  const std::optional<BBR>& bbr() const { return bbr_; }
+
   /* Accessors for use in testing */
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
+  uint64_t zero_window_probes() const { return zero_window_probes_; } // Probes sent since the window closed
+  uint64_t window_size() const { return window_size_; }               // Peer's window, after scaling
+  bool syn_sent() const { return syn_; }                              // Has the SYN been sent?
+  bool syn_acked() const { return recev_seqno_ > 0; }                 // Has the peer acknowledged the SYN?
+  bool fin_sent() const { return fin_; }                              // Has the FIN been sent?
 };
 
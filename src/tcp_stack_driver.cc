@@ -0,0 +1,78 @@
+#include "tcp_stack_driver.hh"
+
+#include "log.hh"
+
+#include <string_view>
+#include <utility>
+
+using namespace std;
+
+TCPStackDriver::TCPStackDriver( FileDescriptor&& device, EventLoop& loop, uint64_t hash_seed )
+  : device_( move( device ) ), demux_( hash_seed )
+{
+  device_.set_blocking( false );
+
+  loop.add_rule( device_, EventLoop::Direction::In, [this] { read_batch(); } );
+  loop.add_rule(
+    device_, EventLoop::Direction::Out, [this] { write_pending(); }, [this] { return not pending_.empty(); } );
+  loop.add_timer( TICK_MS, [this]( uint64_t elapsed ) {
+    demux_.tick( elapsed );
+    if ( activity_callback_ ) {
+      activity_callback_();
+    }
+    flush();
+    // 日志也在定时器里写出去, 不在收发数据的路径上
+    Log::flush();
+  } );
+}
+
+void TCPStackDriver::read_batch()
+{
+  read_batches_++;
+  for ( size_t i = 0; i < READ_BATCH; i++ ) {
+    // 非阻塞的read没有数据时不会增加read_count
+    const auto reads_before = device_.read_count();
+    device_.read( read_buffer_ );
+    if ( device_.read_count() == reads_before or device_.eof() ) {
+      break;
+    }
+
+    InternetDatagram datagram;
+    if ( not parse( datagram, { Buffer { move( read_buffer_ ) } } ) ) {
+      datagrams_dropped_++;
+      continue;
+    }
+    datagrams_received_++;
+    demux_.receive( datagram );
+  }
+  demux_.end_batch();
+  if ( activity_callback_ ) {
+    activity_callback_();
+  }
+  flush();
+}
+
+void TCPStackDriver::flush()
+{
+  while ( auto datagram = demux_.maybe_send() ) {
+    if ( pending_.size() >= MAX_PENDING ) {
+      datagrams_dropped_++;
+      continue;
+    }
+    pending_.push_back( serialize( datagram.value() ) );
+  }
+  write_pending();
+}
+
+void TCPStackDriver::write_pending()
+{
+  vector<string_view> iov;
+  while ( not pending_.empty() ) {
+    iov.assign( pending_.front().begin(), pending_.front().end() );
+    if ( device_.write( iov ) == 0 ) {
+      return; // 设备满了, 等loop报告可写
+    }
+    pending_.pop_front();
+    datagrams_sent_++;
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "tcp_demux.hh"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Runs the minnow TCP stack on a datagram device (a TunFD, or anything else where each read returns
+ * one IPv4 datagram and each write must contain one).
+ *
+ * The driver registers itself with an EventLoop. When the device is readable it reads up to
+ * READ_BATCH datagrams, feeds them all to the TCPDemultiplexer (which coalesces each connection's
+ * in-order segments within the batch), and only then collects the replies, so the stack's ACKs and
+ * data for a burst of arrivals go out together. Each reply is written with a single writev of its
+ * serialized buffers (no copy into a contiguous packet). A timerfd ticks the stack every TICK_MS
+ * milliseconds.
+ *
+ * If the device can't take more datagrams, replies wait in a queue (up to MAX_PENDING) until the
+ * loop reports it writable again.
+ */
+class TCPStackDriver
+{
+public:
+  static constexpr size_t READ_BATCH = 64;
+  static constexpr uint64_t TICK_MS = 10;
+  static constexpr size_t MAX_PENDING = 4096;
+
+  TCPStackDriver( FileDescriptor&& device, EventLoop& loop, uint64_t hash_seed = 0 );
+
+  /* The stack, for opening connections and for the application's reads and writes */
+  TCPDemultiplexer& demux() { return demux_; }
+  const TCPDemultiplexer& demux() const { return demux_; }
+
+  /* Send whatever the stack has queued (call after the application pushes to a connection) */
+  void flush();
+
+  /* Called after each batch of arrivals and each tick, before the replies are sent, so an
+   * application running in the same loop (e.g. a server) can read and write its connections */
+  void set_activity_callback( std::function<void()> callback ) { activity_callback_ = std::move( callback ); }
+
+  /* Statistics */
+  uint64_t datagrams_received() const { return datagrams_received_; }
+  uint64_t datagrams_sent() const { return datagrams_sent_; }
+  uint64_t datagrams_dropped() const { return datagrams_dropped_; }
+  uint64_t read_batches() const { return read_batches_; }
+
+  // The event loop callbacks refer to the driver, so it must stay in place
+  TCPStackDriver( const TCPStackDriver& other ) = delete;
+  TCPStackDriver& operator=( const TCPStackDriver& other ) = delete;
+  TCPStackDriver( TCPStackDriver&& other ) = delete;
+  TCPStackDriver& operator=( TCPStackDriver&& other ) = delete;
+  ~TCPStackDriver() = default;
+
+private:
+  FileDescriptor device_;
+  TCPDemultiplexer demux_;
+  std::deque<std::vector<Buffer>> pending_ {}; // serialized datagrams waiting for the device
+  std::string read_buffer_ {};
+  std::function<void()> activity_callback_ {};
+
+  uint64_t datagrams_received_ {};
+  uint64_t datagrams_sent_ {};
+  uint64_t datagrams_dropped_ {};
+  uint64_t read_batches_ {};
+
+  void read_batch();
+  void write_pending();
+};
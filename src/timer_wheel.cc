@@ -0,0 +1,127 @@
+#include "timer_wheel.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+TimerWheel::TimerId TimerWheel::add_timer( uint64_t key )
+{
+  TimerId id {};
+  if ( free_ids_.empty() ) {
+    id = static_cast<TimerId>( timers_.size() );
+    timers_.emplace_back();
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  timers_.at( id ).key = key;
+  return id;
+}
+
+void TimerWheel::remove_timer( TimerId id )
+{
+  disarm( id );
+  free_ids_.push_back( id );
+}
+
+void TimerWheel::arm( TimerId id, uint64_t deadline_ms )
+{
+  Timer& timer = timers_.at( id );
+  if ( not timer.armed ) {
+    timer.armed = true;
+    armed_count_++;
+  }
+  timer.generation++;
+  timer.deadline = deadline_ms;
+  // the current slot has already been handled, so an overdue timer fires on the next millisecond
+  place( { id, timer.generation }, now_ + 1 );
+}
+
+void TimerWheel::disarm( TimerId id )
+{
+  Timer& timer = timers_.at( id );
+  if ( timer.armed ) {
+    timer.armed = false;
+    timer.generation++;
+    armed_count_--;
+  }
+}
+
+void TimerWheel::tick( uint64_t ms_since_last_tick, const function<void( uint64_t key )>& on_expired )
+{
+  if ( armed_count_ == 0 ) {
+    // nothing can expire: skip ahead and drop the stale entries left behind by re-armed timers
+    now_ += ms_since_last_tick;
+    for ( auto& level : slots_ ) {
+      for ( auto& slot : level ) {
+        slot.clear();
+      }
+    }
+    return;
+  }
+
+  for ( uint64_t i = 0; i < ms_since_last_tick; i++ ) {
+    now_++;
+    for ( unsigned level = 1; level < LEVELS; level++ ) {
+      if ( now_ & ( ( uint64_t { 1 } << ( level * SLOT_BITS ) ) - 1 ) ) {
+        break;
+      }
+      cascade( level );
+    }
+    expire_current_slot( on_expired );
+  }
+}
+
+bool TimerWheel::valid( const Entry& entry ) const
+{
+  const Timer& timer = timers_.at( entry.id );
+  return timer.armed and timer.generation == entry.generation;
+}
+
+// Put an entry in the slot of the finest level whose span covers its deadline (but no earlier than `earliest`).
+void TimerWheel::place( Entry entry, uint64_t earliest )
+{
+  constexpr uint64_t horizon = ( uint64_t { 1 } << ( LEVELS * SLOT_BITS ) ) - 1;
+  const uint64_t when = min( max( timers_.at( entry.id ).deadline, earliest ), now_ + horizon );
+  const uint64_t delta = when - now_;
+
+  unsigned level = 0;
+  while ( level + 1 < LEVELS and delta >= ( uint64_t { 1 } << ( ( level + 1 ) * SLOT_BITS ) ) ) {
+    level++;
+  }
+  slots_.at( level ).at( ( when >> ( level * SLOT_BITS ) ) & ( SLOTS - 1 ) ).push_back( entry );
+}
+
+// Move the entries of the level's current slot down to finer levels now that their span has begun.
+void TimerWheel::cascade( unsigned level )
+{
+  auto& slot = slots_.at( level ).at( ( now_ >> ( level * SLOT_BITS ) ) & ( SLOTS - 1 ) );
+  scratch_.swap( slot );
+  for ( const auto& entry : scratch_ ) {
+    if ( valid( entry ) ) {
+      place( entry, now_ );
+    }
+  }
+  scratch_.clear();
+}
+
+void TimerWheel::expire_current_slot( const function<void( uint64_t key )>& on_expired )
+{
+  auto& slot = slots_.at( 0 ).at( now_ & ( SLOTS - 1 ) );
+  scratch_.swap( slot );
+  for ( const auto& entry : scratch_ ) {
+    if ( not valid( entry ) ) {
+      continue;
+    }
+    Timer& timer = timers_.at( entry.id );
+    if ( timer.deadline > now_ ) {
+      place( entry, now_ + 1 );
+      continue;
+    }
+    timer.armed = false;
+    armed_count_--;
+    // the callback may re-arm this (or any other) timer
+    on_expired( timer.key );
+  }
+  scratch_.clear();
+}
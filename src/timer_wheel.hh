@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+ * A hierarchical timing wheel with millisecond resolution, meant to be shared by many connections.
+ *
+ * Each owner (e.g. a TCPSender) registers one timer and then arms it with an absolute deadline on
+ * the wheel's clock. Advancing the wheel with tick() reports the key of every timer whose deadline
+ * has passed, so the cost of a tick depends on the number of expired timers (plus the handful of
+ * slots that are stepped over), not on the number of registered timers.
+ *
+ * Level 0 has one slot per millisecond; every higher level covers 64 times the span of the level
+ * below it. Timers far in the future live in a coarse slot and are cascaded down as their
+ * deadline approaches. Re-arming or disarming a timer is O(1): the stale slot entry is simply
+ * ignored when its slot comes around.
+ */
+class TimerWheel
+{
+public:
+  using TimerId = uint32_t;
+
+  /* Register a timer that reports `key` when it expires. The timer starts out disarmed. */
+  TimerId add_timer( uint64_t key );
+
+  /* Release a timer (disarming it first). The id may be reused by a later add_timer(). */
+  void remove_timer( TimerId id );
+
+  /* (Re)arm a timer to fire once the wheel's clock reaches `deadline_ms`. */
+  void arm( TimerId id, uint64_t deadline_ms );
+
+  /* Disarm a timer if it is armed */
+  void disarm( TimerId id );
+
+  bool armed( TimerId id ) const { return timers_.at( id ).armed; }
+
+  /* Advance the clock, calling `on_expired( key )` for every timer whose deadline has been reached */
+  void tick( uint64_t ms_since_last_tick, const std::function<void( uint64_t key )>& on_expired );
+
+  /* The wheel's clock, in ms (the sum of all tick() arguments) */
+  uint64_t now() const { return now_; }
+
+  /* Number of armed timers */
+  size_t armed_count() const { return armed_count_; }
+
+private:
+  static constexpr unsigned SLOT_BITS = 6;
+  static constexpr uint64_t SLOTS = 1 << SLOT_BITS;
+  static constexpr unsigned LEVELS = 4;
+
+  struct Timer
+  {
+    uint64_t key {};
+    uint64_t deadline {};
+    uint32_t generation {};
+    bool armed {};
+  };
+
+  // A slot entry is only valid while its generation matches the timer's.
+  struct Entry
+  {
+    TimerId id;
+    uint32_t generation;
+  };
+
+  uint64_t now_ {};
+  size_t armed_count_ {};
+  std::vector<Timer> timers_ {};
+  std::vector<TimerId> free_ids_ {};
+  std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> slots_ {};
+  std::vector<Entry> scratch_ {}; // entries of the slot being processed
+
+  bool valid( const Entry& entry ) const;
+  void place( Entry entry, uint64_t earliest );
+  void cascade( unsigned level );
+  void expire_current_slot( const std::function<void( uint64_t key )>& on_expired );
+};
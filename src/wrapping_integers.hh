@@ -31,4 +31,7 @@ public:
 
   Wrap32 operator+( uint32_t n ) const { return Wrap32 { raw_value_ + n }; }
   bool operator==( const Wrap32& other ) const { return raw_value_ == other.raw_value_; }
+
+  /* The 32-bit value as it appears on the wire */
+  uint32_t raw_value() const { return raw_value_; }
 };
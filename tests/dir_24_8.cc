@@ -0,0 +1,108 @@
+#include "dir_24_8.hh"
+#include "prefix_trie.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+uint32_t ip( uint8_t a, uint8_t b, uint8_t c, uint8_t d )
+{
+  return uint32_t { a } << 24 | uint32_t { b } << 16 | uint32_t { c } << 8 | d;
+}
+
+void basics()
+{
+  Dir24_8 table;
+  expect( not table.lookup( ip( 1, 2, 3, 4 ) ).has_value(), "empty table matches nothing" );
+  expect( table.memory_usage() >= ( size_t { 64 } << 20 ), "the first level is allocated up front" );
+
+  table.insert( ip( 10, 1, 2, 3 ), 32, 4 ); // longer prefixes first: shorter ones must not overwrite them
+  table.insert( ip( 10, 1, 2, 0 ), 30, 3 );
+  expect( table.group_count() == 1, "a second-level group for the /24 holding the long prefixes" );
+  table.insert( ip( 10, 1, 0, 0 ), 16, 2 );
+  table.insert( ip( 10, 0, 0, 0 ), 8, 1 );
+  expect( table.lookup( ip( 10, 1, 2, 3 ) ) == 4, "host route" );
+  expect( table.lookup( ip( 10, 1, 2, 2 ) ) == 3, "/30" );
+  expect( table.lookup( ip( 10, 1, 2, 4 ) ) == 2, "/16 fills the rest of the group" );
+  expect( table.lookup( ip( 10, 1, 3, 4 ) ) == 2, "/16" );
+  expect( table.lookup( ip( 10, 2, 3, 4 ) ) == 1, "/8" );
+  expect( not table.lookup( ip( 11, 0, 0, 0 ) ).has_value(), "no default route" );
+
+  table.insert( 0, 0, 5 );
+  expect( table.lookup( ip( 11, 0, 0, 0 ) ) == 5, "default route" );
+  expect( table.lookup( ip( 10, 1, 2, 3 ) ) == 4, "default route under the longer prefixes" );
+  table.insert( ip( 10, 1, 0, 0 ), 16, 6 );
+  expect( table.lookup( ip( 10, 1, 2, 4 ) ) == 6 and table.lookup( ip( 10, 1, 9, 9 ) ) == 6, "replaced value" );
+
+  table.insert( ip( 10, 1, 7, 0 ), 25, 7 );
+  expect( table.lookup( ip( 10, 1, 7, 200 ) ) == 6, "new group inherits the covering route" );
+  expect( table.group_count() == 2, "one group per expanded /24" );
+
+  bool threw = false;
+  try {
+    table.insert( ip( 1, 0, 0, 0 ), 8, Dir24_8::MAX_VALUE + 1 );
+  } catch ( const out_of_range& ) {
+    threw = true;
+  }
+  expect( threw, "values past 24 bits are refused" );
+}
+
+// The same routes in random order give the same answers as the trie.
+void matches_trie()
+{
+  mt19937 rng { 11 }; // NOLINT(*-msc51-*)
+  uniform_int_distribution<uint32_t> address;
+  uniform_int_distribution<int> length( 8, 32 ); // plus one default route per round
+  for ( int round = 0; round < 5; round++ ) {
+    const uint32_t base = address( rng ) & 0xffff0000;
+    vector<pair<uint32_t, uint8_t>> routes;
+    for ( int i = 0; i < 400; i++ ) {
+      const auto prefix_length = static_cast<uint8_t>( i == 200 ? 0 : length( rng ) );
+      routes.emplace_back( ( base | ( address( rng ) >> 18 ) ) & PrefixTrie::mask( prefix_length ), prefix_length );
+    }
+
+    PrefixTrie trie;
+    Dir24_8 direct;
+    shuffle( routes.begin(), routes.end(), rng );
+    for ( uint32_t value = 0; value < routes.size(); value++ ) {
+      trie.insert( routes[value].first, routes[value].second, value );
+      direct.insert( routes[value].first, routes[value].second, value );
+    }
+    for ( int i = 0; i < 20000; i++ ) {
+      const uint32_t target = i % 4 ? base | ( address( rng ) >> 18 ) : address( rng );
+      expect( direct.lookup( target ) == trie.lookup( target ), "same match as the trie" );
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    basics();
+    matches_trie();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#include "ipv4_header.hh"
+#include "log.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+vector<pair<LogLevel, string>> drain( LogRing& ring )
+{
+  vector<pair<LogLevel, string>> records;
+  ring.drain( [&]( LogLevel level, string_view message ) { records.emplace_back( level, message ); } );
+  return records;
+}
+
+void push_and_drain()
+{
+  LogRing ring { 5 };
+  expect( ring.capacity() == 8, "capacity rounds up to a power of two" );
+  expect( drain( ring ).empty(), "new ring is empty" );
+
+  // several laps around the ring
+  for ( int lap = 0; lap < 3; lap++ ) {
+    for ( int i = 0; i < 8; i++ ) {
+      expect( ring.push( LogLevel::Info, "message " + to_string( i ) ), "push into a ring with room" );
+    }
+    expect( not ring.push( LogLevel::Info, "one too many" ), "push into a full ring fails" );
+    const auto records = drain( ring );
+    expect( records.size() == 8, "drain returns every record" );
+    for ( int i = 0; i < 8; i++ ) {
+      expect( records[i].second == "message " + to_string( i ), "records come out in order" );
+    }
+  }
+  expect( ring.dropped() == 3, "each rejected push counted as dropped" );
+
+  ring.push( LogLevel::Error, string( 1000, 'x' ) );
+  const auto records = drain( ring );
+  expect( records.at( 0 ).first == LogLevel::Error, "level kept" );
+  expect( records.at( 0 ).second == string( LogRing::MAX_MESSAGE, 'x' ), "long message truncated" );
+}
+
+void concurrent_producers()
+{
+  LogRing ring { 256 };
+  constexpr int PRODUCERS = 4;
+  constexpr int PER_PRODUCER = 20000;
+  atomic<int> finished { 0 };
+  vector<thread> producers;
+  for ( int p = 0; p < PRODUCERS; p++ ) {
+    producers.emplace_back( [&, p] {
+      for ( int i = 0; i < PER_PRODUCER; i++ ) {
+        ring.push( LogLevel::Trace, to_string( p ) + ":" + to_string( i ) );
+      }
+      finished++;
+    } );
+  }
+
+  // Records from one producer come out in the order it pushed them
+  vector<int> last( PRODUCERS, -1 );
+  uint64_t received = 0;
+  bool ordered = true;
+  const auto consume = [&]( LogLevel, string_view message ) {
+    const auto colon = message.find( ':' );
+    const int producer = stoi( string( message.substr( 0, colon ) ) );
+    const int index = stoi( string( message.substr( colon + 1 ) ) );
+    ordered = ordered and index > last.at( producer );
+    last.at( producer ) = index;
+    received++;
+  };
+  while ( finished.load() < PRODUCERS ) {
+    ring.drain( consume );
+  }
+  for ( auto& producer : producers ) {
+    producer.join();
+  }
+  ring.drain( consume );
+
+  expect( ordered, "per-producer order preserved" );
+  expect( received + ring.dropped() == PRODUCERS * PER_PRODUCER, "every record received or counted as dropped" );
+}
+
+void compile_time_level()
+{
+  static_assert( Log::enabled( LogLevel::Error ) == ( COMPILED_LOG_LEVEL <= LogLevel::Error ) );
+  static_assert( not Log::enabled( LogLevel::Off ) );
+
+  drain( LogRing::global() );
+  IPv4Header header;
+  header.ttl = 7;
+  Log::trace( "routing ", header );
+  Log::error( "code ", 42, ' ', "failed" );
+  const auto records = drain( LogRing::global() );
+
+  size_t expected = 0;
+  if constexpr ( Log::enabled( LogLevel::Trace ) ) {
+    expect( records.at( expected ).second == "routing " + header.to_string(), "trace formats its arguments" );
+    expected++;
+  }
+  if constexpr ( Log::enabled( LogLevel::Error ) ) {
+    expect( records.at( expected ).first == LogLevel::Error, "error logged at its level" );
+    expect( records.at( expected ).second == "code 42 failed", "numbers and characters formatted" );
+    expected++;
+  }
+  expect( records.size() == expected, "disabled levels write nothing" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    push_and_drain();
+    concurrent_producers();
+    compile_time_level();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
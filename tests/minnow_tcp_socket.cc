@@ -0,0 +1,173 @@
+#include "minnow_tcp_socket.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t CLIENT_ADDRESS = 0x0a000001; // 10.0.0.1
+constexpr uint16_t SERVER_PORT = 7;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+// An echo server on a second stack, sharing the socket's event loop
+void serve_echo( TCPStackDriver& server, vector<TCPDemultiplexer::ConnectionId>& connections )
+{
+  TCPDemultiplexer& demux = server.demux();
+  while ( auto id = demux.accept( SERVER_PORT ) ) {
+    connections.push_back( id.value() );
+  }
+  erase_if( connections, [&]( auto id ) { return not demux.has_connection( id ); } );
+  for ( const auto id : connections ) {
+    Reader& in = demux.peer( id ).inbound_reader();
+    Writer& out = demux.peer( id ).outbound_writer();
+    while ( in.bytes_buffered() and out.available_capacity() ) {
+      const auto data = in.peek().substr( 0, out.available_capacity() );
+      out.push( string( data ) );
+      in.pop( data.size() );
+    }
+    if ( in.is_finished() and not out.is_closed() ) {
+      out.close();
+    }
+    demux.push( id );
+  }
+}
+
+void echo_round_trip()
+{
+  auto [client_end, server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket sock { move( client_end ), CLIENT_ADDRESS };
+  TCPStackDriver server { move( server_end ), sock.event_loop() };
+  server.demux().listen( SERVER_PORT, TCPConfig {} );
+  vector<TCPDemultiplexer::ConnectionId> connections;
+  server.set_activity_callback( [&] { serve_echo( server, connections ); } );
+
+  sock.connect( Address { "10.0.0.2", SERVER_PORT } );
+  expect( sock.peer_address().to_string() == "10.0.0.2:7", "peer address" );
+  expect( sock.local_address().ip() == "10.0.0.1", "local address" );
+
+  // More than the default capacity, so write() has to wait for the echo to be read
+  string sent;
+  for ( unsigned int i = 0; sent.size() < 3 * TCPConfig::DEFAULT_CAPACITY; i++ ) {
+    sent += to_string( i ) + " ";
+  }
+  string received, buf;
+  for ( size_t offset = 0; offset < sent.size(); offset += 1000 ) {
+    expect( sock.write( sent.substr( offset, 1000 ) ) == min<size_t>( 1000, sent.size() - offset ), "write all" );
+    while ( received.size() < offset ) {
+      sock.read( buf );
+      received += buf;
+    }
+  }
+  sock.close();
+  while ( not sock.eof() ) {
+    sock.read( buf );
+    received += buf;
+  }
+  expect( received == sent, "echo matches" );
+  sock.read( buf );
+  expect( buf.empty(), "read at EOF is empty" );
+}
+
+// Run the event loop for a while, so closed connections are reaped
+void let_time_pass( MinnowTCPSocket& sock )
+{
+  for ( int i = 0; i < 10; i++ ) {
+    sock.event_loop().wait_next_event( 2 * TCPStackDriver::TICK_MS );
+  }
+}
+
+// A connection that ended while nobody was reading still reads as EOF, or as a reset if it was one.
+void reaped_before_read()
+{
+  auto [client_end, server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket sock { move( client_end ), CLIENT_ADDRESS };
+  TCPStackDriver server { move( server_end ), sock.event_loop() };
+  server.demux().listen( SERVER_PORT, TCPConfig {} );
+  sock.connect( Address { "10.0.0.2", SERVER_PORT } );
+  let_time_pass( sock );
+  const auto first = server.demux().accept( SERVER_PORT );
+  expect( first.has_value(), "server accepts" );
+
+  // The server says goodbye and closes first; the client reads everything, then closes too
+  server.demux().peer( first.value() ).outbound_writer().push( "bye" );
+  server.demux().peer( first.value() ).outbound_writer().close();
+  server.demux().push( first.value() );
+  server.flush();
+  string received, buf;
+  while ( not sock.eof() ) {
+    sock.read( buf );
+    received += buf;
+  }
+  expect( received == "bye", "the goodbye arrives" );
+  sock.close();
+  let_time_pass( sock );
+  expect( sock.eof(), "still at EOF once the connection is released" );
+  sock.read( buf );
+  expect( buf.empty(), "read after the release is empty, not an error" );
+
+  // A reset connection that has been released still reports the reset
+  auto [reset_client_end, reset_server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket reset_sock { move( reset_client_end ), CLIENT_ADDRESS };
+  TCPStackDriver reset_server { move( reset_server_end ), reset_sock.event_loop() };
+  reset_server.demux().listen( SERVER_PORT, TCPConfig {} );
+  reset_sock.connect( Address { "10.0.0.2", SERVER_PORT } );
+  let_time_pass( reset_sock );
+  const auto doomed = reset_server.demux().accept( SERVER_PORT );
+  expect( doomed.has_value(), "server accepts again" );
+  reset_server.demux().peer( doomed.value() ).abort();
+  reset_server.demux().push( doomed.value() );
+  reset_server.flush();
+  let_time_pass( reset_sock );
+  expect( not reset_sock.eof(), "a reset is not EOF" );
+  bool reset = false;
+  try {
+    reset_sock.read( buf );
+  } catch ( const runtime_error& e ) {
+    reset = string( e.what() ).find( "reset" ) != string::npos;
+  }
+  expect( reset, "read reports the reset" );
+}
+
+void connection_refused()
+{
+  auto [client_end, server_end] = MinnowTCPSocket::local_link();
+  MinnowTCPSocket sock { move( client_end ), CLIENT_ADDRESS };
+  const TCPStackDriver server { move( server_end ), sock.event_loop() }; // nobody listening
+
+  bool refused = false;
+  try {
+    sock.connect( Address { "10.0.0.2", SERVER_PORT } );
+  } catch ( const runtime_error& ) {
+    refused = true;
+  }
+  expect( refused, "connect to a closed port throws" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    echo_round_trip();
+    reaped_before_read();
+    connection_refused();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
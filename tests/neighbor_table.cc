@@ -0,0 +1,255 @@
+#include "arp_message.hh"
+#include "network_interface.hh"
+#include "neighbor_table.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr EthernetAddress ROUTER_A_ETH { 0x02, 0, 0, 0, 0, 0x0a };
+constexpr EthernetAddress ROUTER_B_ETH { 0x02, 0, 0, 0, 0, 0x0b };
+constexpr EthernetAddress NEIGHBOR_ETH { 0x02, 0, 0, 0, 0, 0x01 };
+constexpr EthernetAddress OTHER_ETH { 0x02, 0, 0, 0, 0, 0x02 };
+constexpr uint32_t NEIGHBOR_IP = 0x0a000001; // 10.0.0.1
+constexpr uint64_t MAPPING_TTL_MS = 30000;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+InternetDatagram make_datagram()
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( "10.0.0.100", 0 ).ipv4_numeric();
+  dgram.header.dst = Address( "10.0.5.5", 0 ).ipv4_numeric();
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.front().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+EthernetFrame arp_reply( const EthernetAddress& sender_eth, const EthernetAddress& target_eth )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = sender_eth;
+  arp.sender_ip_address = NEIGHBOR_IP;
+  arp.target_ethernet_address = target_eth;
+  arp.target_ip_address = Address( "10.0.0.100", 0 ).ipv4_numeric();
+  return { { target_eth, sender_eth, EthernetHeader::TYPE_ARP }, serialize( arp ) };
+}
+
+void lookup_and_expiry()
+{
+  NeighborTable table;
+  expect( not table.lookup( NEIGHBOR_IP ).has_value(), "empty table has no mapping" );
+
+  table.publish( NEIGHBOR_IP, NEIGHBOR_ETH, 1000 );
+  auto entry = table.lookup( NEIGHBOR_IP );
+  expect( entry.has_value() and entry->ethernet_address == NEIGHBOR_ETH, "published mapping is visible" );
+  expect( entry->expires_ms == 1000, "expiry is on the table's clock" );
+
+  table.tick( 999 );
+  expect( table.lookup( NEIGHBOR_IP ).has_value(), "mapping valid until its expiry" );
+  table.tick( 1 );
+  expect( not table.lookup( NEIGHBOR_IP ).has_value(), "mapping gone at its expiry" );
+
+  table.publish( NEIGHBOR_IP, OTHER_ETH, 1000 );
+  expect( table.lookup( NEIGHBOR_IP )->ethernet_address == OTHER_ETH, "republished mapping replaces the old one" );
+  table.erase( NEIGHBOR_IP );
+  expect( not table.lookup( NEIGHBOR_IP ).has_value(), "erased mapping is gone" );
+  expect( table.size() == 0, "expired entries are dropped when a snapshot is published" );
+}
+
+// Refreshing an unchanged mapping does not copy the table; the refreshes are published together, in time.
+void refreshes_are_batched()
+{
+  NeighborTable table;
+  table.publish( NEIGHBOR_IP, NEIGHBOR_ETH, 1000 );
+  table.publish( NEIGHBOR_IP + 1, OTHER_ETH, 1000 );
+  expect( table.snapshots_published() == 2, "new mappings are published right away" );
+
+  table.tick( 500 );
+  for ( int i = 0; i < 10; i++ ) {
+    table.publish( NEIGHBOR_IP, NEIGHBOR_ETH, 1000 );
+    table.publish( NEIGHBOR_IP + 1, OTHER_ETH, 1000 );
+  }
+  expect( table.snapshots_published() == 2, "refreshes of unchanged mappings are not published one by one" );
+  expect( table.lookup( NEIGHBOR_IP )->expires_ms == 1000, "a lookup still sees the earlier expiry" );
+
+  table.tick( 499 );
+  expect( table.snapshots_published() == 2, "nothing is published while the old expiries are in the future" );
+  table.tick( 1 );
+  expect( table.snapshots_published() == 3, "all the refreshes go out in one snapshot" );
+  expect( table.lookup( NEIGHBOR_IP )->expires_ms == 1500 and table.lookup( NEIGHBOR_IP + 1 )->expires_ms == 1500,
+          "before the old expiry passes" );
+
+  // A changed address is published right away, with the pending refreshes
+  table.publish( NEIGHBOR_IP + 1, OTHER_ETH, 1000 );
+  table.publish( NEIGHBOR_IP, OTHER_ETH, 1000 );
+  expect( table.snapshots_published() == 4, "a new address is published" );
+  expect( table.lookup( NEIGHBOR_IP )->ethernet_address == OTHER_ETH, "with the new address" );
+  expect( table.lookup( NEIGHBOR_IP + 1 )->expires_ms == 2000, "and the pending refresh" );
+  table.tick( 1000 );
+  expect( table.snapshots_published() == 4 and not table.lookup( NEIGHBOR_IP ).has_value(), "both expire" );
+}
+
+void reclamation_waits_for_readers()
+{
+  auto table = make_shared<NeighborTable>();
+  NeighborTable::Reader first { table };
+  const NeighborTable::Reader second { table };
+
+  table->publish( NEIGHBOR_IP, NEIGHBOR_ETH, 1000 );
+  expect( table->retired_snapshots() == 1, "old snapshot kept while readers may use it" );
+
+  first.quiescent();
+  table->tick( 1 );
+  expect( table->retired_snapshots() == 1, "one reader has not passed a quiescent state" );
+
+  second.quiescent();
+  table->tick( 1 );
+  expect( table->retired_snapshots() == 0, "freed once every reader was quiescent" );
+
+  // A copy is a reader of its own, and a reader going away no longer holds anything up
+  auto copy = make_unique<NeighborTable::Reader>( first );
+  table->publish( NEIGHBOR_IP, OTHER_ETH, 1000 );
+  first.quiescent();
+  second.quiescent();
+  table->tick( 1 );
+  expect( table->retired_snapshots() == 1, "the copy has to be quiescent too" );
+  copy.reset();
+  expect( table->retired_snapshots() == 0, "freed when the last holdout unregisters" );
+
+  // A reader registered after a snapshot was retired cannot be using it
+  table->publish( NEIGHBOR_IP, NEIGHBOR_ETH, 1000 );
+  const NeighborTable::Reader late { table };
+  first.quiescent();
+  second.quiescent();
+  table->tick( 1 );
+  expect( table->retired_snapshots() == 0, "new reader does not hold up older snapshots" );
+}
+
+void interfaces_share_neighbors()
+{
+  auto table = make_shared<NeighborTable>();
+  const Address ip( "10.0.0.100", 0 );
+  NetworkInterface a { ROUTER_A_ETH, ip };
+  NetworkInterface b { ROUTER_B_ETH, ip };
+  a.attach_neighbor_table( table );
+  b.attach_neighbor_table( table );
+  const Address next_hop = Address::from_ipv4_numeric( NEIGHBOR_IP );
+
+  // a resolves the neighbor with ARP
+  a.send_datagram( make_datagram(), next_hop );
+  auto request = a.maybe_send();
+  expect( request.has_value() and request->header.type == EthernetHeader::TYPE_ARP, "a sends an ARP request" );
+  a.recv_frame( arp_reply( NEIGHBOR_ETH, ROUTER_A_ETH ) );
+  expect( a.maybe_send().has_value(), "a sends the queued datagram" );
+  expect( table->lookup( NEIGHBOR_IP ).has_value(), "a published the mapping" );
+
+  // b uses a's mapping, with b's own source address, and without asking
+  b.send_datagram( make_datagram(), next_hop );
+  auto frame = b.maybe_send();
+  expect( frame.has_value() and frame->header.type == EthernetHeader::TYPE_IPv4, "b sends the datagram directly" );
+  expect( frame->header.dst == NEIGHBOR_ETH and frame->header.src == ROUTER_B_ETH, "b's frame is addressed right" );
+  expect( not b.maybe_send().has_value(), "b sends no ARP request" );
+  expect( b.neighbors_adopted() == 1, "b adopted one mapping" );
+  b.send_datagram( make_datagram(), next_hop );
+  expect( b.maybe_send().has_value() and b.neighbors_adopted() == 1, "then b uses its own copy" );
+
+  // The adopted mapping expires when a's does
+  for ( auto* interface : { &a, &b } ) {
+    interface->tick( MAPPING_TTL_MS - 1 );
+  }
+  table->tick( MAPPING_TTL_MS - 1 );
+  b.send_datagram( make_datagram(), next_hop );
+  expect( b.maybe_send()->header.type == EthernetHeader::TYPE_IPv4, "adopted mapping valid until a's expires" );
+  for ( auto* interface : { &a, &b } ) {
+    interface->tick( 1 );
+  }
+  table->tick( 1 );
+  b.send_datagram( make_datagram(), next_hop );
+  expect( b.maybe_send()->header.type == EthernetHeader::TYPE_ARP, "b asks once the mapping expired everywhere" );
+
+  // A later answer to b is shared with a
+  b.recv_frame( arp_reply( OTHER_ETH, ROUTER_B_ETH ) );
+  expect( b.maybe_send()->header.dst == OTHER_ETH, "b sends its queued datagram" );
+  a.send_datagram( make_datagram(), next_hop );
+  frame = a.maybe_send();
+  expect( frame->header.type == EthernetHeader::TYPE_IPv4 and frame->header.dst == OTHER_ETH, "a uses b's answer" );
+
+  // Interfaces without a table are unaffected
+  NetworkInterface alone { OTHER_ETH, ip };
+  alone.send_datagram( make_datagram(), next_hop );
+  expect( alone.maybe_send()->header.type == EthernetHeader::TYPE_ARP, "unattached interface uses ARP" );
+}
+
+// Readers look up concurrently with a writer; snapshots still get freed.
+void concurrent_readers()
+{
+  auto table = make_shared<NeighborTable>();
+  constexpr uint64_t UPDATES = 20000;
+  atomic<bool> done { false };
+  atomic<uint64_t> bad_lookups { 0 };
+
+  vector<thread> readers;
+  for ( int i = 0; i < 3; i++ ) {
+    readers.emplace_back( [&, reader = NeighborTable::Reader { table }] {
+      while ( not done.load() ) {
+        for ( uint32_t ip = 0; ip < 16; ip++ ) {
+          const auto entry = table->lookup( ip );
+          if ( entry.has_value() and entry->ethernet_address.at( 5 ) != ip ) {
+            bad_lookups++;
+          }
+        }
+        reader.quiescent();
+      }
+    } );
+  }
+
+  for ( uint64_t i = 0; i < UPDATES; i++ ) {
+    const auto ip = static_cast<uint32_t>( i % 16 );
+    table->publish( ip, { 0x02, 0, 0, 0, static_cast<uint8_t>( i ), static_cast<uint8_t>( ip ) }, 1000 );
+  }
+  done = true;
+  for ( auto& reader : readers ) {
+    reader.join();
+  }
+  table->tick( 1 );
+
+  expect( bad_lookups == 0, "lookups never see a torn entry" );
+  expect( table->snapshots_published() == UPDATES, "every update published a snapshot" );
+  expect( table->retired_snapshots() == 0, "all snapshots freed once the readers are gone" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    lookup_and_expiry();
+    refreshes_are_batched();
+    reclamation_waits_for_readers();
+    interfaces_share_neighbors();
+    concurrent_readers();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -320,6 +320,305 @@ int main()
         serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.5" ) ) ) } );
       test.execute( ExpectNoFrame {} );
     }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "mapping expires exactly at its deadline", local_eth, Address( "10.0.0.1", 0 ) };
+
+      test.execute( ReceiveFrame {
+        make_frame(
+          remote_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP,
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.2", local_eth, "10.0.0.1" ) ) ),
+        {} } );
+
+      // valid for the whole 30 seconds, in ticks of different sizes
+      test.execute( Tick { 1 } );
+      test.execute( Tick { 20000 } );
+      test.execute( Tick { 9998 } );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // gone at exactly 30 seconds
+      test.execute( Tick { 1 } );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "refreshed mapping outlives its first deadline", local_eth, Address( "10.0.0.1", 0 ) };
+      const auto reply = make_frame(
+        remote_eth,
+        local_eth,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.2", local_eth, "10.0.0.1" ) ) );
+
+      test.execute( ReceiveFrame { reply, {} } );
+      test.execute( Tick { 20000 } );
+      test.execute( ReceiveFrame { reply, {} } ); // new deadline: 50 seconds
+
+      // the first deadline passes without evicting the refreshed mapping
+      test.execute( Tick { 10000 } );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( Tick { 19999 } );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // and it expires 30 seconds after the refresh
+      test.execute( Tick { 1 } );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+      test.execute( SendDatagram { datagram3, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "ARP request throttle is re-armed", local_eth, Address( "10.0.0.1", 0 ) };
+      const auto request = make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+
+      for ( int round = 0; round < 3; round++ ) {
+        // one request per 5 seconds, however often the datagram is retried
+        test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+        test.execute( ExpectFrame { request } );
+        test.execute( Tick { 4999 } );
+        test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+        test.execute( ExpectNoFrame {} );
+        test.execute( Tick { 1 } );
+      }
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "pending datagrams are queued per next hop", local_eth, Address( "10.0.0.1", 0 ) };
+
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) ) } );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.3", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.3" ) ) ) } );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.2", 0 ), 1 } );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.3", 0 ), 1 } );
+
+      // the second hop answers first: only its datagram goes out, the first stays queued
+      test.execute( ReceiveFrame {
+        make_frame(
+          remote_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP,
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.3", local_eth, "10.0.0.1" ) ) ),
+        {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.2", 0 ), 1 } );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.3", 0 ), 0 } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "pending queue is bounded", local_eth, Address( "10.0.0.1", 0 ) };
+
+      vector<InternetDatagram> datagrams;
+      for ( size_t i = 0; i < NetworkInterface::MAX_PENDING_PER_HOP + 3; i++ ) {
+        datagrams.push_back( make_datagram( "5.6.7.8", "13.12.11." + to_string( i ) ) );
+        test.execute( SendDatagram { datagrams.back(), Address( "10.0.0.2", 0 ) } );
+      }
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.2", 0 ), NetworkInterface::MAX_PENDING_PER_HOP } );
+      test.execute( ExpectPendingDropped { 3 } );
+
+      // the oldest three were dropped; the rest go out in order
+      test.execute( ReceiveFrame {
+        make_frame(
+          remote_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP,
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.2", local_eth, "10.0.0.1" ) ) ),
+        {} } );
+      for ( size_t i = 3; i < datagrams.size(); i++ ) {
+        test.execute(
+          ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagrams[i] ) ) } );
+      }
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { Address( "10.0.0.2", 0 ), 0 } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "frames in wire format", local_eth, Address( "10.0.0.1", 0 ) };
+
+      test.execute( ReceiveFrame {
+        make_frame(
+          remote_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP,
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.2", local_eth, "10.0.0.1" ) ) ),
+        {} } );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectSerializedFrame {
+        make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( ExpectSerializedFrame {
+        make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "batch receive and drain", local_eth, Address( "10.0.0.1", 0 ) };
+
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+
+      // an ARP request from the remote host, two datagrams for us, and one for somebody else
+      test.execute( ReceiveFrames {
+        { make_frame(
+            remote_eth,
+            ETHERNET_BROADCAST,
+            EthernetHeader::TYPE_ARP,
+            serialize( make_arp( ARPMessage::OPCODE_REQUEST, remote_eth, "10.0.0.2", {}, "10.0.0.1" ) ) ),
+          make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ),
+          make_frame(
+            remote_eth, random_private_ethernet_address(), EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ),
+          make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( datagram3 ) ) },
+        { datagram, datagram3 } } );
+
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectDrainedFrames {
+        { make_frame(
+            local_eth,
+            remote_eth,
+            EthernetHeader::TYPE_ARP,
+            serialize( make_arp( ARPMessage::OPCODE_REPLY, local_eth, "10.0.0.1", remote_eth, "10.0.0.2" ) ) ),
+          make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "gratuitous ARP at startup", local_eth, Address( "10.0.0.1", 0 ), ARPConfig { .gratuitous_arp = true } };
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.1" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      const EthernetAddress idle_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "mappings in use are refreshed before they expire",
+                                         local_eth,
+                                         Address( "10.0.0.1", 0 ),
+                                         ARPConfig { .refresh_before_expiry_ms = 3000 } };
+
+      for ( const auto& [eth, ip] : { pair { remote_eth, "10.0.0.2" }, pair { idle_eth, "10.0.0.3" } } ) {
+        test.execute( ReceiveFrame {
+          make_frame( eth,
+                      local_eth,
+                      EthernetHeader::TYPE_ARP,
+                      serialize( make_arp( ARPMessage::OPCODE_REPLY, eth, ip, local_eth, "10.0.0.1" ) ) ),
+          {} } );
+      }
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+
+      test.execute( Tick { 26999 } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( Tick { 1 } );
+      // the mapping in use gets a unicast request; the idle one doesn't
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        remote_eth,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectRefreshesSent { 1 } );
+
+      // the old mapping is still used while the refresh is outstanding
+      test.execute( Tick { 1000 } );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( ReceiveFrame {
+        make_frame(
+          remote_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP,
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.2", local_eth, "10.0.0.1" ) ) ),
+        {} } );
+
+      // past the original expiry: the refreshed mapping is still good, the idle one is gone
+      test.execute( Tick { 5000 } );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.2", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.3", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.3" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << endl;
     return EXIT_FAILURE;
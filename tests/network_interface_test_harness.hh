@@ -18,6 +18,15 @@ public:
                    "eth=" + to_string( ethernet_address ) + ", ip=" + ip_address.ip(),
                    NetworkInterface { ethernet_address, ip_address } )
   {}
+
+  NetworkInterfaceTestHarness( std::string test_name,
+                               const EthernetAddress& ethernet_address,
+                               const Address& ip_address,
+                               const ARPConfig& config )
+    : TestHarness( move( test_name ),
+                   "eth=" + to_string( ethernet_address ) + ", ip=" + ip_address.ip(),
+                   NetworkInterface { ethernet_address, ip_address, config } )
+  {}
 };
 
 inline std::string summary( const EthernetFrame& frame );
@@ -93,6 +102,58 @@ struct ReceiveFrame : public Action<NetworkInterface>
   {}
 };
 
+struct ReceiveFrames : public Action<NetworkInterface>
+{
+  std::vector<EthernetFrame> frames;
+  std::vector<InternetDatagram> expected;
+
+  std::string description() const override { return std::to_string( frames.size() ) + " frames arrive at once"; }
+  void execute( NetworkInterface& interface ) const override
+  {
+    std::vector<InternetDatagram> out;
+    const size_t count = interface.recv_frames( frames, out );
+    if ( count != out.size() or out.size() != expected.size() ) {
+      throw ExpectationViolation( "NetworkInterface::recv_frames() passed up " + std::to_string( out.size() )
+                                  + " datagrams, but " + std::to_string( expected.size() ) + " were expected" );
+    }
+    for ( size_t i = 0; i < out.size(); i++ ) {
+      if ( not equal( out[i], expected[i] ) ) {
+        throw ExpectationViolation( "NetworkInterface::recv_frames() produced a different Internet datagram than "
+                                    "was expected: actual={"
+                                    + out[i].header.to_string() + "}" );
+      }
+    }
+  }
+
+  ReceiveFrames( std::vector<EthernetFrame> f, std::vector<InternetDatagram> e )
+    : frames( std::move( f ) ), expected( std::move( e ) )
+  {}
+};
+
+struct ExpectDrainedFrames : public Expectation<NetworkInterface>
+{
+  std::vector<EthernetFrame> expected;
+
+  std::string description() const override { return std::to_string( expected.size() ) + " frames drained"; }
+  void execute( NetworkInterface& interface ) const override
+  {
+    std::vector<EthernetFrame> out;
+    if ( interface.drain_frames( out ) != expected.size() or out.size() != expected.size() ) {
+      throw ExpectationViolation( "NetworkInterface::drain_frames() returned " + std::to_string( out.size() )
+                                  + " frames, but " + std::to_string( expected.size() ) + " were expected" );
+    }
+    for ( size_t i = 0; i < out.size(); i++ ) {
+      if ( not equal( out[i], expected[i] ) ) {
+        throw ExpectationViolation( "NetworkInterface::drain_frames() returned a different Ethernet frame than was "
+                                    "expected: actual={"
+                                    + summary( out[i] ) + "}" );
+      }
+    }
+  }
+
+  explicit ExpectDrainedFrames( std::vector<EthernetFrame> e ) : expected( std::move( e ) ) {}
+};
+
 struct ExpectFrame : public Expectation<NetworkInterface>
 {
   EthernetFrame expected;
@@ -114,6 +175,27 @@ struct ExpectFrame : public Expectation<NetworkInterface>
   explicit ExpectFrame( EthernetFrame e ) : expected( std::move( e ) ) {}
 };
 
+struct ExpectSerializedFrame : public Expectation<NetworkInterface>
+{
+  EthernetFrame expected;
+
+  std::string description() const override { return "frame transmitted in wire format (" + summary( expected ) + ")"; }
+  void execute( NetworkInterface& interface ) const override
+  {
+    auto wire = interface.maybe_send_serialized();
+    if ( not wire.has_value() ) {
+      throw ExpectationViolation( "NetworkInterface was expected to send an Ethernet frame, but did not" );
+    }
+
+    EthernetFrame frame;
+    if ( not parse( frame, wire.value() ) or not equal( frame, expected ) ) {
+      throw ExpectationViolation( "NetworkInterface sent a different Ethernet frame than was expected" );
+    }
+  }
+
+  explicit ExpectSerializedFrame( EthernetFrame e ) : expected( std::move( e ) ) {}
+};
+
 struct ExpectNoFrame : public Expectation<NetworkInterface>
 {
   std::string description() const override { return "no frame transmitted"; }
@@ -135,6 +217,29 @@ struct Tick : public Action<NetworkInterface>
   explicit Tick( const size_t ms ) : _ms( ms ) {}
 };
 
+struct ExpectPendingDatagrams : public ExpectNumber<NetworkInterface, size_t>
+{
+  Address next_hop;
+
+  ExpectPendingDatagrams( Address n, size_t count ) : ExpectNumber( count ), next_hop( std::move( n ) ) {}
+  std::string name() const override { return "pending_datagrams(" + next_hop.ip() + ")"; }
+  size_t value( NetworkInterface& interface ) const override { return interface.pending_datagrams( next_hop ); }
+};
+
+struct ExpectRefreshesSent : public ExpectNumber<NetworkInterface, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "refreshes_sent"; }
+  uint64_t value( NetworkInterface& interface ) const override { return interface.refreshes_sent(); }
+};
+
+struct ExpectPendingDropped : public ExpectNumber<NetworkInterface, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pending_dropped"; }
+  uint64_t value( NetworkInterface& interface ) const override { return interface.pending_dropped(); }
+};
+
 inline std::string concat( std::vector<Buffer>& buffers )
 {
   return std::accumulate(
@@ -0,0 +1,97 @@
+#include "exception.hh"
+#include "packet_ring.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint16_t TEST_ETHERTYPE = 0x88b5; // IEEE 802 local experimental ethertype
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+vector<Buffer> wire_frame( unsigned int n )
+{
+  const EthernetFrame frame { { { 0x02, 0, 0, 0, 0, 1 }, { 0x02, 0, 0, 0, 0, 2 }, TEST_ETHERTYPE },
+                              { Buffer { "frame " }, Buffer { to_string( n ) } } };
+  return serialize( frame );
+}
+
+// Send frames over the loopback interface through the TX ring and receive them through the RX ring.
+void loopback_round_trip( PacketRing& ring )
+{
+  constexpr unsigned int N = 200;
+  vector<vector<Buffer>> frames;
+  for ( unsigned int i = 0; i < N; i++ ) {
+    frames.push_back( wire_frame( i ) );
+  }
+  expect( ring.send_frames( frames ) == N, "all frames fit in the TX ring" );
+
+  vector<EthernetFrame> received;
+  for ( unsigned int tries = 0; tries < 100 and received.size() < N; tries++ ) {
+    pollfd pfd { ring.fd_num(), POLLIN, 0 };
+    CheckSystemCall( "poll", poll( &pfd, 1, 10 ) );
+    ring.recv_frames( received );
+  }
+  expect( received.size() == N, "received " + to_string( received.size() ) + " of " + to_string( N ) + " frames" );
+  for ( unsigned int i = 0; i < N; i++ ) {
+    expect( received[i].header.type == TEST_ETHERTYPE, "ethertype" );
+    expect( received[i].header.src == EthernetAddress { 0x02, 0, 0, 0, 0, 2 }, "source address" );
+    const string payload { received[i].payload.front() };
+    expect( payload.starts_with( "frame " + to_string( i ) ), "payload of frame " + to_string( i ) );
+  }
+}
+
+void oversized_frames_are_refused( PacketRing& ring )
+{
+  const vector<Buffer> huge { Buffer { string( 4096, 'x' ) } };
+  expect( not ring.queue( huge ), "a frame larger than a TX slot is refused" );
+  expect( ring.tx_dropped() == 1, "and counted" );
+}
+
+optional<PacketRing> open_ring()
+{
+  try {
+    return optional<PacketRing> { in_place, "lo", TEST_ETHERTYPE };
+  } catch ( const unix_error& e ) {
+    if ( e.error_code() == EPERM or e.error_code() == EACCES ) {
+      return {};
+    }
+    throw;
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto ring = open_ring();
+    if ( not ring.has_value() ) {
+      cerr << "packet_ring: skipped (packet sockets need CAP_NET_RAW)\n";
+      return EXIT_SUCCESS;
+    }
+    loopback_round_trip( ring.value() );
+    oversized_frames_are_refused( ring.value() );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
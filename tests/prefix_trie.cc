@@ -0,0 +1,108 @@
+#include "prefix_trie.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+uint32_t ip( uint8_t a, uint8_t b, uint8_t c, uint8_t d )
+{
+  return uint32_t { a } << 24 | uint32_t { b } << 16 | uint32_t { c } << 8 | d;
+}
+
+void basics()
+{
+  PrefixTrie trie;
+  expect( not trie.lookup( ip( 1, 2, 3, 4 ) ).has_value(), "empty trie matches nothing" );
+
+  trie.insert( ip( 10, 0, 0, 0 ), 8, 1 );
+  trie.insert( ip( 10, 1, 0, 0 ), 16, 2 );
+  trie.insert( ip( 10, 1, 2, 0 ), 24, 3 );
+  trie.insert( ip( 10, 1, 2, 3 ), 32, 4 );
+  trie.insert( ip( 10, 128, 0, 0 ), 9, 5 ); // branches off next to 10.1/16
+  expect( trie.lookup( ip( 10, 1, 2, 3 ) ) == 4, "host route" );
+  expect( trie.lookup( ip( 10, 1, 2, 4 ) ) == 3, "/24" );
+  expect( trie.lookup( ip( 10, 1, 3, 4 ) ) == 2, "/16" );
+  expect( trie.lookup( ip( 10, 2, 3, 4 ) ) == 1, "/8" );
+  expect( trie.lookup( ip( 10, 200, 3, 4 ) ) == 5, "/9" );
+  expect( not trie.lookup( ip( 11, 1, 2, 3 ) ).has_value(), "no default route" );
+
+  trie.insert( 0, 0, 6 );
+  expect( trie.lookup( ip( 11, 1, 2, 3 ) ) == 6, "default route" );
+  trie.insert( ip( 10, 1, 0, 0 ), 16, 7 );
+  expect( trie.lookup( ip( 10, 1, 3, 4 ) ) == 7, "replaced value" );
+  expect( trie.size() == 6, "replacing does not add a prefix" );
+
+  trie.insert( ip( 192, 168, 1, 77 ), 24, 8 );
+  expect( trie.find( ip( 192, 168, 1, 0 ), 24 ) == 8, "host bits ignored" );
+  expect( not trie.find( ip( 192, 168, 0, 0 ), 16 ).has_value(), "find is exact" );
+  expect( not trie.find( ip( 10, 0, 0, 0 ), 12 ).has_value(), "branching nodes are not prefixes" );
+}
+
+// Compare with a brute-force longest match over random prefixes, clustered so that they nest.
+void random_tables()
+{
+  mt19937 rng { 7 }; // NOLINT(*-msc51-*)
+  uniform_int_distribution<uint32_t> address;
+  uniform_int_distribution<int> length( 0, 32 );
+  for ( int round = 0; round < 20; round++ ) {
+    PrefixTrie trie;
+    map<pair<uint32_t, uint8_t>, uint32_t> routes;
+    const uint32_t base = address( rng ) & 0xff000000;
+    for ( uint32_t value = 0; value < 500; value++ ) {
+      const auto prefix_length = static_cast<uint8_t>( length( rng ) );
+      const uint32_t prefix = ( base | ( address( rng ) >> 8 ) ) & PrefixTrie::mask( prefix_length );
+      trie.insert( prefix, prefix_length, value );
+      routes[{ prefix, prefix_length }] = value;
+    }
+    expect( trie.size() == routes.size(), "one entry per distinct prefix" );
+    expect( trie.node_count() <= 2 * routes.size() + 1, "fewer than two nodes per prefix" );
+
+    for ( int i = 0; i < 2000; i++ ) {
+      const uint32_t target = ( i % 2 ? base : 0 ) | ( address( rng ) >> ( i % 2 ? 8 : 0 ) );
+      optional<uint32_t> best {};
+      int best_length = -1;
+      for ( const auto& [route, value] : routes ) {
+        if ( ( target & PrefixTrie::mask( route.second ) ) == route.first and route.second > best_length ) {
+          best = value;
+          best_length = route.second;
+        }
+      }
+      expect( trie.lookup( target ) == best, "same match as a linear scan" );
+    }
+    for ( const auto& [route, value] : routes ) {
+      expect( trie.find( route.first, route.second ) == value, "every prefix found" );
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    basics();
+    random_tables();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -28,10 +28,19 @@ struct ReceiverSetTestStep : public TestStep<ReceiverSet>
 class TCPReceiverTestHarness : public TestHarness<ReceiverSet>
 {
 public:
-  TCPReceiverTestHarness( std::string test_name, uint64_t capacity )
+  TCPReceiverTestHarness( std::string test_name,
+                          uint64_t capacity,
+                          std::optional<uint8_t> window_scale = {} )
     : TestHarness( move( test_name ),
                    "capacity=" + std::to_string( capacity ),
-                   { { ByteStream { capacity }, Reassembler {} }, TCPReceiver {} } )
+                   { { ByteStream { capacity }, Reassembler {} }, TCPReceiver { window_scale } } )
+  {}
+
+  TCPReceiverTestHarness( std::string test_name, const TCPConfig& config )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( config.recv_capacity ) + ", delayed_ack_ms="
+                     + std::to_string( config.delayed_ack_ms ),
+                   { { ByteStream { config.recv_capacity }, Reassembler {} }, TCPReceiver { config } } )
   {}
 
   template<std::derived_from<TestStep<StreamAndReassembler>> T>
@@ -56,6 +65,88 @@ struct ExpectWindow : public ExpectNumber<ReceiverSet, uint16_t>
   uint16_t value( ReceiverSet& rs ) const override { return rs.second.send( rs.first.first.writer() ).window_size; }
 };
 
+struct ExpectWindowScale : public ExpectNumber<ReceiverSet, uint8_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "window_scale"; }
+  uint8_t value( ReceiverSet& rs ) const override { return rs.second.window_scale(); }
+};
+
+struct ExpectPeerWindowScale : public ExpectNumber<ReceiverSet, std::optional<uint8_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "peer_window_scale"; }
+  std::optional<uint8_t> value( ReceiverSet& rs ) const override { return rs.second.peer_window_scale(); }
+};
+
+struct ExpectAckDue : public ExpectNumber<ReceiverSet, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "ack_due"; }
+  std::optional<uint64_t> value( ReceiverSet& rs ) const override
+  {
+    return rs.second.ack_due( rs.first.first.writer() );
+  }
+};
+
+struct ReceiverTick : public Action<ReceiverSet>
+{
+  uint64_t ms_;
+
+  explicit ReceiverTick( uint64_t ms ) : ms_( ms ) {}
+  std::string description() const override { return std::to_string( ms_ ) + " ms pass"; }
+  void execute( ReceiverSet& rs ) const override { rs.second.tick( ms_ ); }
+};
+
+struct Autotune : public Action<ReceiverSet>
+{
+  std::string description() const override { return "auto-tune the receive window"; }
+  void execute( ReceiverSet& rs ) const override { rs.second.autotune( rs.first.first.writer() ); }
+};
+
+struct ExpectCapacity : public ExpectNumber<ReceiverSet, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "capacity"; }
+  uint64_t value( ReceiverSet& rs ) const override { return rs.first.first.writer().capacity(); }
+};
+
+struct ExpectReceiveRtt : public ExpectNumber<ReceiverSet, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "receive_rtt"; }
+  std::optional<uint64_t> value( ReceiverSet& rs ) const override { return rs.second.receive_rtt(); }
+};
+
+struct ExpectDelayedAck : public Expectation<ReceiverSet>
+{
+  std::optional<Wrap32> ackno_;
+
+  explicit ExpectDelayedAck( std::optional<Wrap32> ackno ) : ackno_( ackno ) {}
+  std::string description() const override { return "maybe_ack() sends ackno=" + to_string( ackno_ ); }
+  void execute( ReceiverSet& rs ) const override
+  {
+    const auto ack = rs.second.maybe_ack( rs.first.first.writer() );
+    if ( not ack.has_value() ) {
+      throw ExpectationViolation( "TCPReceiver did not send an ACK when one was due" );
+    }
+    if ( ack->ackno != ackno_ ) {
+      throw ExpectationViolation( "ackno", ackno_, ack->ackno );
+    }
+  }
+};
+
+struct ExpectNoDelayedAck : public Expectation<ReceiverSet>
+{
+  std::string description() const override { return "maybe_ack() sends nothing"; }
+  void execute( ReceiverSet& rs ) const override
+  {
+    if ( rs.second.maybe_ack( rs.first.first.writer() ).has_value() ) {
+      throw ExpectationViolation( "TCPReceiver sent an ACK that was not due" );
+    }
+  }
+};
+
 struct ExpectAckno : public ExpectNumber<ReceiverSet, std::optional<Wrap32>>
 {
   using ExpectNumber::ExpectNumber;
@@ -115,6 +206,12 @@ struct SegmentArrives : public Action<ReceiverSet>
     return *this;
   }
 
+  SegmentArrives& with_window_scale( uint8_t shift )
+  {
+    msg_.window_scale = shift;
+    return *this;
+  }
+
   SegmentArrives& with_fin()
   {
     msg_.FIN = true;
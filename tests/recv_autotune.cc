@@ -0,0 +1,153 @@
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    const string full( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.recv_capacity_max = 20000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "receive window grows with the drain rate and shrinks when idle", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { 4000 } );
+
+      // one full segment every 5 ms, read by the application right away
+      uint32_t seqno = isn + 1;
+      for ( unsigned int i = 0; i < 4; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { 5 } );
+        seqno += full.size();
+      }
+      // a window's worth of data took 15 ms to arrive
+      test.execute( ExpectReceiveRtt { 15 } );
+      test.execute( ExpectCapacity { 4000 } );
+
+      for ( unsigned int i = 0; i < 4; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { 5 } );
+        seqno += full.size();
+      }
+      // 3000 bytes drained per RTT: the buffer grows to twice that
+      test.execute( ExpectCapacity { 6000 } );
+      test.execute( ExpectWindow { 6000 } );
+
+      // the sender speeds up to 1000 bytes/ms: the buffer follows the bandwidth-delay product
+      for ( unsigned int i = 0; i < 100; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { 1 } );
+        seqno += full.size();
+      }
+      test.execute( ExpectReceiveRtt { 5 } );
+      test.execute( ExpectCapacity { 10000 } );
+
+      // idle: after four quiet RTTs (the first round still saw reads) the buffer is halved,
+      // but never below recv_capacity
+      for ( unsigned int i = 0; i < 5; i++ ) {
+        test.execute( ReceiverTick { 5 } );
+        test.execute( Autotune {} );
+      }
+      test.execute( ExpectCapacity { 5000 } );
+      for ( unsigned int i = 0; i < 8; i++ ) {
+        test.execute( ReceiverTick { 5 } );
+        test.execute( Autotune {} );
+      }
+      test.execute( ExpectCapacity { 4000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.recv_capacity_max = 20000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "shrinking never retracts the advertised right edge", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      uint32_t seqno = isn + 1;
+      for ( unsigned int i = 0; i < 108; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { i < 8 ? 5U : 1U } );
+        seqno += full.size();
+      }
+      test.execute( ExpectCapacity { 10000 } );
+      // the peer is told it may send 10000 bytes past seqno
+      test.execute( ExpectDelayedAck { Wrap32 { seqno } } );
+      test.execute( ExpectWindow { 10000 } );
+
+      // idle: the buffer would be halved, but the window just advertised is held open
+      for ( unsigned int i = 0; i < 5; i++ ) {
+        test.execute( ReceiverTick { 5 } );
+        test.execute( Autotune {} );
+      }
+      test.execute( ExpectCapacity { 10000 } );
+
+      // as the peer fills that window and the application reads it, the buffer comes down behind it
+      for ( unsigned int i = 1; i <= 5; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( Autotune {} );
+        seqno += full.size();
+        test.execute( ExpectCapacity { 10000 - 1000 * i } );
+        test.execute( ExpectWindow { static_cast<uint16_t>( 10000 - 1000 * i ) } );
+      }
+      test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+      test.execute( ReadAll { full } );
+      test.execute( Autotune {} );
+      test.execute( ExpectCapacity { 5000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.recv_capacity_max = 5000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "auto-tuning stops at recv_capacity_max", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      uint32_t seqno = isn + 1;
+      for ( unsigned int i = 0; i < 100; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { 1 } );
+        seqno += full.size();
+      }
+      test.execute( ExpectCapacity { 5000 } );
+      test.execute( ExpectWindow { 5000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "without recv_capacity_max the window stays fixed", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      uint32_t seqno = isn + 1;
+      for ( unsigned int i = 0; i < 20; i++ ) {
+        test.execute( SegmentArrives {}.with_seqno( seqno ).with_data( full ) );
+        test.execute( ReadAll { full } );
+        test.execute( ReceiverTick { 5 } );
+        seqno += full.size();
+      }
+      test.execute( ExpectReceiveRtt { nullopt } );
+      test.execute( ExpectCapacity { 4000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    const string full( TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+    TCPConfig cfg;
+    cfg.delayed_ack_ms = 40;
+    cfg.recv_capacity = 10000;
+
+    {
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "ACK every second full segment", cfg };
+      test.execute( ExpectAckDue { nullopt } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      test.execute( ExpectAckDue { nullopt } );
+      test.execute( ReceiverTick { 5 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( full ) );
+      test.execute( ExpectAckDue { 45 } );
+      test.execute( ExpectNoDelayedAck {} );
+      test.execute( ReceiverTick { 1 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( full ) );
+      test.execute( ExpectAckDue { 6 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 2001 } } );
+      test.execute( ExpectAckDue { nullopt } );
+    }
+
+    {
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "ACK after the delayed-ACK timeout", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ReceiverTick { 10 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ) );
+      test.execute( ExpectAckDue { 40 } );
+      test.execute( ReceiverTick { 29 } );
+      test.execute( ExpectNoDelayedAck {} );
+      test.execute( ReceiverTick { 1 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 7 } } );
+      // pure ACKs from the peer don't need acknowledging
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ) );
+      test.execute( ExpectAckDue { nullopt } );
+    }
+
+    {
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "ACK immediately on out-of-order and duplicate data", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 4 ).with_data( "def" ) );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      // filling the hole is acknowledged immediately as well
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 7 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 7 } } );
+      // a zero-window probe (one below the ackno) gets an immediate answer
+      test.execute( SegmentArrives {}.with_seqno( isn + 6 ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 7 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_fin() );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 8 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 8 ) );
+      test.execute( ExpectAckDue { nullopt } );
+    }
+
+    {
+      const uint32_t isn = 23452;
+      TCPConfig small = cfg;
+      small.recv_capacity = 3000;
+      TCPReceiverTestHarness test { "ACK immediately when the window opens", small };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( full ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1001 ).with_data( full ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2001 ).with_data( full ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 3001 } } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( ExpectAckDue { nullopt } );
+      test.execute( ReadAll { string( 3000, 'x' ) } );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 3001 } } );
+      test.execute( ExpectWindow { 3000 } );
+    }
+
+    {
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "without a delay every segment is acknowledged", TCPConfig {} };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 1 } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abc" ) );
+      test.execute( ExpectAckDue { 0 } );
+      test.execute( ExpectDelayedAck { Wrap32 { isn + 4 } } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.sws_avoidance = true;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "window opens in MSS-sized steps", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { 4000 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 4000, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 10 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 989 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Pop { 1500 } );
+      test.execute( ExpectWindow { 2000 } );
+      // new data takes up window, but the right edge never moves backward
+      test.execute( SegmentArrives {}.with_seqno( isn + 4001 ).with_data( "abc" ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 4004 } } );
+      test.execute( ExpectWindow { 1997 } );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindow { 2997 } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 600;
+      cfg.sws_avoidance = true;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "small buffers open in steps of half the buffer", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 600, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 299 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 300 } );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "without SWS avoidance every freed byte is announced", cfg };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 4000, 'x' ) ) );
+      test.execute( Pop { 10 } );
+      test.execute( ExpectWindow { 10 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      const size_t cap = 1000000;
+      const uint32_t isn = 23452;
+      const uint8_t shift = TCPConfig::window_scale_for( cap );
+      TCPReceiverTestHarness test { "window scale lets the receiver advertise more than 64 KiB", cap, shift };
+      test.execute( ExpectWindow { UINT16_MAX } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 7 ) );
+      test.execute( ExpectWindowScale { shift } );
+      test.execute( ExpectPeerWindowScale { 7 } );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 } } );
+      test.execute( ExpectWindow { cap >> shift } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( 100, 'x' ) ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 101 } } );
+      // the window is rounded down, never over-advertised
+      test.execute( ExpectWindow { ( cap - 100 ) >> shift } );
+    }
+
+    {
+      const size_t cap = 1000000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "no window scaling unless the peer's SYN offers it", cap, 4 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindowScale { 0 } );
+      test.execute( ExpectPeerWindowScale { nullopt } );
+      test.execute( ExpectWindow { UINT16_MAX } );
+    }
+
+    {
+      const size_t cap = 1000000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "no window scaling unless we offered it", cap };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 4 ) );
+      test.execute( ExpectWindowScale { 0 } );
+      test.execute( ExpectPeerWindowScale { nullopt } );
+      test.execute( ExpectWindow { UINT16_MAX } );
+    }
+
+    {
+      const size_t cap = 1UL << 29;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "window scale shift is capped at 14", cap, 14 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_window_scale( 200 ) );
+      test.execute( ExpectPeerWindowScale { 14 } );
+      test.execute( ExpectWindow { cap >> 14 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -119,7 +119,7 @@ public:
 class Network
 {
 private:
-  Router _router {};
+  Router _router;
 
   size_t default_id, eth0_id, eth1_id, eth2_id, uun3_id, hs4_id, mit5_id;
 
@@ -173,8 +173,9 @@ private:
   }
 
 public:
-  Network()
-    : default_id( _router.add_interface( { random_router_ethernet_address(), Address { "171.67.76.46" } } ) )
+  explicit Network( Router::ForwardingTable forwarding_table )
+    : _router( forwarding_table )
+    , default_id( _router.add_interface( { random_router_ethernet_address(), Address { "171.67.76.46" } } ) )
     , eth0_id( _router.add_interface( { random_router_ethernet_address(), Address { "10.0.0.1" } } ) )
     , eth1_id( _router.add_interface( { random_router_ethernet_address(), Address { "172.16.0.1" } } ) )
     , eth2_id( _router.add_interface( { random_router_ethernet_address(), Address { "192.168.0.1" } } ) )
@@ -240,14 +241,14 @@ public:
   }
 };
 
-void network_simulator()
+void network_simulator( Router::ForwardingTable forwarding_table )
 {
   const string green = "\033[32;1m";
   const string normal = "\033[m";
 
   cerr << green << "Constructing network." << normal << "\n";
 
-  Network network;
+  Network network { forwarding_table };
 
   cout << green << "\n\nTesting traffic between two ordinary hosts (applesauce to cherrypie)..." << normal
        << "\n\n";
@@ -329,7 +330,8 @@ void network_simulator()
 int main()
 {
   try {
-    network_simulator();
+    network_simulator( Router::ForwardingTable::PrefixTrie );
+    network_simulator( Router::ForwardingTable::Dir24_8 );
   } catch ( const exception& e ) {
     cerr << "\n\n\n";
     cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
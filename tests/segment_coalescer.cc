@@ -0,0 +1,169 @@
+#include "segment_coalescer.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+TCPSegment segment( uint32_t seqno, string payload, bool syn = false, bool fin = false )
+{
+  TCPSegment seg;
+  seg.sender_message.seqno = Wrap32 { seqno };
+  seg.sender_message.SYN = syn;
+  seg.sender_message.payload = move( payload );
+  seg.sender_message.FIN = fin;
+  return seg;
+}
+
+string_view payload( const TCPSegment& seg )
+{
+  return seg.sender_message.payload;
+}
+
+vector<TCPSegment> pop_all( SegmentCoalescer& gro )
+{
+  vector<TCPSegment> out;
+  while ( auto msg = gro.pop() ) {
+    out.push_back( move( msg.value() ) );
+  }
+  return out;
+}
+
+void merges_in_order_burst()
+{
+  SegmentCoalescer gro;
+  gro.push( segment( 100, "", true ) );
+  gro.push( segment( 101, "abc" ) );
+  gro.push( segment( 104, "def" ) );
+  gro.push( segment( 107, "ghi" ) );
+  expect( pop_all( gro ).empty(), "nothing completed before the batch ends" );
+  gro.end_batch();
+  const auto out = pop_all( gro );
+  expect( out.size() == 1, "one merged segment" );
+  expect( out[0].sender_message.SYN and out[0].sender_message.seqno == Wrap32 { 100 }, "merged segment keeps the SYN" );
+  expect( payload( out[0] ) == "abcdefghi", "payloads concatenated" );
+  expect( gro.segments_in() == 4 and gro.segments_out() == 1, "statistics" );
+}
+
+void flushes_on_gap_flags_and_acks()
+{
+  SegmentCoalescer gro;
+  gro.push( segment( 1, "ab" ) );
+  gro.push( segment( 3, "cd" ) );
+  gro.push( segment( 10, "xy" ) ); // gap
+  gro.push( segment( 12, "" ) );   // pure ACK
+  gro.push( segment( 12, "zz" ) );
+  gro.push( segment( 14, "w", false, true ) ); // FIN ends the merged segment
+  gro.push( segment( 16, "late" ) );
+  gro.end_batch();
+  const auto out = pop_all( gro );
+  expect( out.size() == 5, "five segments out, got " + to_string( out.size() ) );
+  expect( out[0].sender_message.seqno == Wrap32 { 1 } and payload( out[0] ) == "abcd", "first burst" );
+  expect( out[1].sender_message.seqno == Wrap32 { 10 } and payload( out[1] ) == "xy", "after the gap" );
+  expect( out[2].sender_message.payload.empty(), "pure ACK passed through in order" );
+  expect( payload( out[3] ) == "zzw" and out[3].sender_message.FIN, "FIN merged and flushed" );
+  expect( payload( out[4] ) == "late", "segment after the FIN kept separate" );
+}
+
+void flushes_on_reset_and_new_acks()
+{
+  SegmentCoalescer gro;
+  gro.push( segment( 1, "ab" ) );
+  auto reset = segment( 3, "cd" );
+  reset.RST = true;
+  gro.push( reset );
+  gro.push( segment( 5, "ef" ) );
+  auto acking = segment( 7, "gh" );
+  acking.receiver_message.ackno = Wrap32 { 500 };
+  gro.push( acking );
+  auto window = segment( 9, "ij" );
+  window.receiver_message.ackno = Wrap32 { 500 };
+  window.receiver_message.window_size = 1000;
+  gro.push( window );
+  gro.end_batch();
+  const auto out = pop_all( gro );
+  expect( out.size() == 5, "nothing merged across an RST or an ACK change, got " + to_string( out.size() ) );
+  expect( payload( out[0] ) == "ab" and not out[0].RST, "data before the RST" );
+  expect( payload( out[1] ) == "cd" and out[1].RST, "the RST is passed through" );
+  expect( payload( out[2] ) == "ef", "data after the RST starts a new segment" );
+  expect( payload( out[3] ) == "gh" and out[3].receiver_message.ackno == Wrap32 { 500 }, "new ackno" );
+  expect( payload( out[4] ) == "ij" and out[4].receiver_message.window_size == 1000, "new window" );
+}
+
+void respects_size_limit()
+{
+  SegmentCoalescer gro { 5 };
+  gro.push( segment( 0, "abc" ) );
+  gro.push( segment( 3, "de" ) );
+  gro.push( segment( 5, "f" ) );
+  gro.end_batch();
+  const auto out = pop_all( gro );
+  expect( out.size() == 2, "split at the size limit" );
+  expect( payload( out[0] ) == "abcde" and payload( out[1] ) == "f", "contents" );
+}
+
+void leaves_caller_buffers_alone()
+{
+  SegmentCoalescer gro;
+  const auto first = segment( 0, "abc" );
+  gro.push( first );
+  gro.push( segment( 3, "def" ) );
+  gro.end_batch();
+  expect( payload( pop_all( gro )[0] ) == "abcdef", "merged" );
+  expect( payload( first ) == "abc", "caller's copy of the payload is untouched" );
+}
+
+void feeds_peer()
+{
+  const uint32_t isn = 1000;
+  TCPConfig config;
+  config.recv_capacity = 10000;
+  TCPPeer peer { config };
+  SegmentCoalescer gro;
+
+  gro.push( segment( isn, "", true ) );
+  for ( uint32_t i = 0; i < 10; i++ ) {
+    gro.push( segment( isn + 1 + i * 100, string( 100, static_cast<char>( 'a' + i ) ) ) );
+  }
+  gro.end_batch();
+  expect( gro.drain( peer ) == 1 and gro.segments_out() == 1, "one insert for the whole burst" );
+  expect( peer.inbound_reader().bytes_buffered() == 1000, "all data delivered" );
+  const auto& out = peer.drain_outgoing();
+  expect( not out.empty() and out.back().receiver_message.ackno == Wrap32 { isn + 1001 }, "ackno" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    merges_in_order_burst();
+    flushes_on_gap_flags_and_acks();
+    flushes_on_reset_and_new_acks();
+    respects_size_limit();
+    leaves_caller_buffers_alone();
+    feeds_peer();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
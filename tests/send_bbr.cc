@@ -0,0 +1,97 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.bbr = true;
+
+      TCPSenderTestHarness test { "BBR: initial window, pacing and bandwidth estimate", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectPacingRate { 0 } );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      // min RTT = 10 ms, so Startup paces at 2.885 * 10 segments / 10 ms
+      test.execute( ExpectPacingRate { 2885000 } );
+
+      // the window is limited by the initial congestion window (10 segments plus the acked SYN)
+      test.execute( Push( string( 20000, 'x' ) ) );
+      test.execute( ExpectSeqnosInFlight { 10001 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextSendTime { 11 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1 ).with_seqno( isn + 10001 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // everything is acked 50 ms after the first data segment was sent: 10001 bytes / 50 ms
+      test.execute( Tick { 46 } );
+      test.execute( AckReceived { Wrap32 { isn + 10002 } }.with_win( 60000 ).without_push() );
+      test.execute( ExpectBottleneckBandwidth { 200020 } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      // Startup never lowers the pacing rate
+      test.execute( ExpectPacingRate { 2885000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 100;
+      cfg.bbr = true;
+
+      TCPSenderTestHarness test { "BBR: retransmitted segments don't update the RTT estimate", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 20 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 100 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectPacingRate { 1442500 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.nagle = true;
+
+      TCPSenderTestHarness test { "Nagle coalesces small writes while data is in flight", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      // nothing in flight: the first small write goes out right away
+      test.execute( Push( "a" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push( "b" ) );
+      test.execute( Push( "c" ) );
+      test.execute( Push( "d" ) );
+      test.execute( ExpectNoSegment {} );
+      // the ACK releases everything written in the meantime as one segment
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "bcd" ).with_seqno( isn + 2 ) );
+      // full-sized segments are never held back
+      test.execute( Push( string( 1500, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 5 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 1003 } );
+      // a FIN isn't delayed
+      test.execute( Close {} );
+      test.execute( ExpectMessage {}.with_fin( true ).with_payload_size( 500 ).with_seqno( isn + 1005 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.nagle = true;
+
+      TCPSenderTestHarness test { "no_delay overrides Nagle", cfg };
+      test.execute( SetNoDelay { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "a" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ) );
+      test.execute( Push( "b" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "b" ) );
+      test.execute( SetNoDelay { false } );
+      test.execute( Push( "c" ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Pacing disabled: a large window is filled at once", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( string( 4000, 'x' ) ) );
+      test.execute( ExpectNextSendTime { 0 } );
+      for ( unsigned int i = 0; i < 4; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextSendTime { {} } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.pacing = true;
+      cfg.pacing_rate = 100000; // 100 bytes per ms
+
+      TCPSenderTestHarness test { "Fixed pacing rate spaces out segments after the initial burst", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( string( 4000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextSendTime { 1 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextSendTime { 11 } );
+      test.execute( Tick { 9 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 3001 ) );
+      test.execute( ExpectNextSendTime { {} } );
+      test.execute( ExpectSeqnosInFlight { 4000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.pacing = true;
+
+      TCPSenderTestHarness test { "Derived pacing rate follows window / SRTT", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      // SRTT = 100 ms, so rate = 1.25 * 4000 / 0.1 s = 50 bytes per ms
+      test.execute( Push( string( 4000, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextSendTime { 120 } );
+      test.execute( Tick { 19 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
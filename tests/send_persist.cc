@@ -0,0 +1,121 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = rto;
+      cfg.persist_timer = true;
+
+      TCPSenderTestHarness test { "Persist timer probes a zero window with backoff and no data", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+
+      uint64_t interval = rto;
+      for ( unsigned int i = 1; i <= 4; i++ ) {
+        test.execute( Tick { interval - 1 } );
+        test.execute( ExpectNoSegment {} );
+        test.execute( Tick { 1 } );
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 0 ).with_seqno( isn ) );
+        test.execute( ExpectNoSegment {} );
+        test.execute( ExpectSeqnosInFlight { 0 } );
+        test.execute( ExpectZeroWindowProbes { i } );
+        test.execute( ExpectConsecutiveRetransmissions { 0 } );
+        interval = min<uint64_t>( interval * 2, 60000 );
+      }
+
+      // the probe's ACK still shows a zero window
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // the window opens: the data goes out and probing stops
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectZeroWindowProbes { 0 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 10 ) );
+      test.execute( Tick { 100 * rto } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = rto;
+      cfg.persist_timer = true;
+
+      TCPSenderTestHarness test { "Persist timer: a zero window seen before the SYN does not hold it back", cfg };
+      test.execute( Receive { { {}, 0 } }.without_push() );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectSeqnosInFlight { 1 } );
+      test.execute( Tick { rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectZeroWindowProbes { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = rto;
+      cfg.persist_timer = true;
+
+      TCPSenderTestHarness test { "Persist timer: data already in flight backs off when the window closes", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 3 ) );
+      test.execute( Push( "abcdef" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 2 * rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 2 } );
+
+      // everything acked but the window is still closed: switch to probing
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 0 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 0 ).with_seqno( isn + 3 ) );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "d" ).with_seqno( isn + 4 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
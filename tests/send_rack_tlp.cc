@@ -0,0 +1,134 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.rack_tlp = true;
+
+      TCPSenderTestHarness test { "Tail loss probe retransmits the last segment after 2*SRTT", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectMessage {}.with_data( "def" ).with_seqno( isn + 4 ) );
+      test.execute( Tick { 19 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "def" ).with_seqno( isn + 4 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      // only one probe per episode; the RTO restarts when the probe is sent
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.rack_tlp = true;
+
+      TCPSenderTestHarness test { "A lone segment waits for the peer's delayed ACK before probing", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "hello" ) );
+      test.execute( ExpectMessage {}.with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { 219 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 6 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( Tick { 5000 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.rack_tlp = true;
+
+      TCPSenderTestHarness test { "RACK: duplicate ACKs mark the head lost once it is SRTT + reo_wnd old", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectMessage {}.with_data( "def" ).with_seqno( isn + 4 ) );
+      test.execute( Push( "ghi" ) );
+      test.execute( ExpectMessage {}.with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( Tick { 5 } );
+      // "def" arrived, "abc" did not: a single duplicate ACK is enough, but reordering is allowed for a while
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).without_push() );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 6 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).without_push() );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      // no tail loss probe while the loss is being repaired
+      test.execute( Tick { 50 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 10 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Without RACK-TLP, only the RTO retransmits", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ).without_push() );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ).with_seqno( isn + 1 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.window_scale = 5;
+
+      TCPSenderTestHarness test { "SYN carries the window scale option", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_window_scale( 5 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_window_scale( nullopt ).with_data( "abc" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+
+      TCPSenderTestHarness test { "SYN has no window scale option unless configured", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_window_scale( nullopt ).with_seqno( isn ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.fixed_isn = isn;
+      cfg.send_capacity = 1000000;
+      cfg.window_scale = 7;
+
+      TCPSenderTestHarness test { "Sender fills a scaled window beyond 64 KiB", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( SetPeerWindowScale { 7 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectWindowSize { 128000 } );
+      test.execute( Push( string( 200000, 'x' ) ) );
+      for ( unsigned int i = 0; i < 128; i++ ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 1 + i * 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 128000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 + 64000 } }.with_win( 1000 ) );
+      for ( unsigned int i = 128; i < 192; i++ ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 1000 ).with_seqno( isn + 1 + i * 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
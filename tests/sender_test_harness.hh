@@ -54,6 +54,62 @@ struct ExpectSeqnosInFlight : public ExpectNumber<StreamAndSender, uint64_t>
   uint64_t value( StreamAndSender& ss ) const override { return ss.second.sequence_numbers_in_flight(); }
 };
 
+struct ExpectConsecutiveRetransmissions : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "consecutive_retransmissions"; }
+  uint64_t value( StreamAndSender& ss ) const override { return ss.second.consecutive_retransmissions(); }
+};
+
+struct ExpectZeroWindowProbes : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "zero_window_probes"; }
+  uint64_t value( StreamAndSender& ss ) const override { return ss.second.zero_window_probes(); }
+};
+
+struct ExpectWindowSize : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "window_size"; }
+  uint64_t value( StreamAndSender& ss ) const override { return ss.second.window_size(); }
+};
+
+struct ExpectPacingRate : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  uint64_t value( StreamAndSender& ss ) const override { return ss.second.pacing_rate(); }
+};
+
+struct ExpectBottleneckBandwidth : public ExpectNumber<StreamAndSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "bbr().bottleneck_bandwidth"; }
+  uint64_t value( StreamAndSender& ss ) const override
+  {
+    if ( not ss.second.bbr().has_value() ) {
+      throw ExpectationViolation( "TCPSender is not using BBR" );
+    }
+    return ss.second.bbr()->bottleneck_bandwidth();
+  }
+};
+
+struct ExpectNextSendTime : public Expectation<StreamAndSender>
+{
+  std::optional<uint64_t> time_;
+
+  explicit ExpectNextSendTime( std::optional<uint64_t> time ) : time_( time ) {}
+  std::string description() const override { return "next_send_time = " + to_string( time_ ); }
+  void execute( StreamAndSender& ss ) const override
+  {
+    const auto actual = ss.second.next_send_time();
+    if ( actual != time_ ) {
+      throw ExpectationViolation( "next_send_time", time_, actual );
+    }
+  }
+};
+
 struct ExpectNoSegment : public Expectation<StreamAndSender>
 {
   std::string description() const override { return "nothing to send"; }
@@ -187,6 +243,24 @@ struct AckReceived : public Receive
   explicit AckReceived( Wrap32 ackno ) : Receive( { ackno, DEFAULT_TEST_WINDOW } ) {}
 };
 
+struct SetPeerWindowScale : public Action<StreamAndSender>
+{
+  uint8_t shift_;
+
+  explicit SetPeerWindowScale( uint8_t shift ) : shift_( shift ) {}
+  std::string description() const override { return "peer window scale negotiated: " + std::to_string( shift_ ); }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_peer_window_scale( shift_ ); }
+};
+
+struct SetNoDelay : public Action<StreamAndSender>
+{
+  bool no_delay_;
+
+  explicit SetNoDelay( bool no_delay ) : no_delay_( no_delay ) {}
+  std::string description() const override { return "set no_delay = " + std::to_string( no_delay_ ); }
+  void execute( StreamAndSender& ss ) const override { ss.second.set_no_delay( no_delay_ ); }
+};
+
 struct Close : public Push
 {
   Close() : Push( "" ) { with_close(); }
@@ -199,6 +273,7 @@ struct ExpectMessage : public Expectation<StreamAndSender>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<std::optional<uint8_t>> window_scale {};
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -233,6 +308,12 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     return *this;
   }
 
+  ExpectMessage& with_window_scale( std::optional<uint8_t> window_scale_ )
+  {
+    window_scale = window_scale_;
+    return *this;
+  }
+
   ExpectMessage& with_data( std::string data_ )
   {
     data = std::move( data_ );
@@ -261,6 +342,9 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     if ( fin.has_value() ) {
       o << ( fin.value() ? " +FIN" : " (no FIN)" );
     }
+    if ( window_scale.has_value() ) {
+      o << " window_scale=" << to_string( window_scale.value() );
+    }
     return o.str();
   }
 
@@ -284,6 +368,9 @@ struct ExpectMessage : public Expectation<StreamAndSender>
     if ( fin.has_value() and seg.FIN != fin.value() ) {
       throw ExpectationViolation( "FIN flag", fin.value(), seg.FIN );
     }
+    if ( window_scale.has_value() and seg.window_scale != window_scale.value() ) {
+      throw ExpectationViolation( "window scale option", window_scale.value(), seg.window_scale );
+    }
     if ( seqno.has_value() and seg.seqno != seqno.value() ) {
       throw ExpectationViolation( "sequence number", seqno.value(), seg.seqno );
     }
@@ -307,6 +394,6 @@ public:
   TCPSenderTestHarness( std::string name, TCPConfig config )
     : TestHarness( move( name ),
                    "initial_RTO_ms=" + to_string( config.rt_timeout ),
-                   { ByteStream { config.send_capacity }, TCPSender { config.rt_timeout, config.fixed_isn } } )
+                   { ByteStream { config.send_capacity }, TCPSender { config } } )
   {}
 };
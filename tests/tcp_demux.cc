@@ -0,0 +1,331 @@
+#include "tcp_demux.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t CLIENT_ADDRESS = 0x0a000001; // 10.0.0.1
+constexpr uint32_t SERVER_ADDRESS = 0x0a000002; // 10.0.0.2
+constexpr uint16_t SERVER_PORT = 80;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+// Serialize each datagram and parse it back, as if it had crossed a real network.
+InternetDatagram over_the_wire( const InternetDatagram& dgram )
+{
+  InternetDatagram parsed;
+  expect( parse( parsed, serialize( dgram ) ), "datagram survives serialization" );
+  return parsed;
+}
+
+// Deliver everything each side has to send, until both are quiet.
+size_t exchange( TCPDemultiplexer& a, TCPDemultiplexer& b )
+{
+  size_t delivered = 0;
+  bool progress = true;
+  while ( progress ) {
+    progress = false;
+    for ( auto [from, to] : { pair { &a, &b }, pair { &b, &a } } ) {
+      while ( auto dgram = from->maybe_send() ) {
+        to->receive( over_the_wire( dgram.value() ) );
+        progress = true;
+        delivered++;
+      }
+    }
+  }
+  return delivered;
+}
+
+string read_all( TCPPeer& peer )
+{
+  string out;
+  while ( peer.inbound_reader().bytes_buffered() ) {
+    out.append( peer.inbound_reader().peek() );
+    peer.inbound_reader().pop( peer.inbound_reader().peek().size() );
+  }
+  return out;
+}
+
+TCPDemultiplexer::FlowKey client_flow( uint16_t port )
+{
+  return { CLIENT_ADDRESS, SERVER_ADDRESS, port, SERVER_PORT };
+}
+
+void many_connections()
+{
+  constexpr size_t N = 2000;
+  TCPDemultiplexer client { 1 };
+  TCPDemultiplexer server { 2 };
+  server.listen( SERVER_PORT, TCPConfig {}, N );
+
+  vector<TCPDemultiplexer::ConnectionId> client_ids;
+  for ( size_t i = 0; i < N; i++ ) {
+    client_ids.push_back( client.connect( client_flow( 10000 + i ), TCPConfig {} ) );
+  }
+  exchange( client, server );
+  expect( client.connection_count() == N and server.connection_count() == N, "all connections exist" );
+  expect( server.table_capacity() >= 2 * N, "the flow table keeps its load factor at most 1/2" );
+
+  vector<TCPDemultiplexer::ConnectionId> server_ids;
+  while ( auto id = server.accept( SERVER_PORT ) ) {
+    server_ids.push_back( id.value() );
+  }
+  expect( server_ids.size() == N, "every connection is accepted" );
+
+  // Each client sends its port number; the server echoes it back.
+  for ( size_t i = 0; i < N; i++ ) {
+    client.peer( client_ids[i] ).outbound_writer().push( to_string( 10000 + i ) );
+    client.push( client_ids[i] );
+  }
+  exchange( client, server );
+  for ( const auto id : server_ids ) {
+    const string request = read_all( server.peer( id ) );
+    expect( request == to_string( server.flow( id ).remote_port ), "request reaches the right connection" );
+    server.peer( id ).outbound_writer().push( request );
+    server.peer( id ).outbound_writer().close();
+    server.push( id );
+  }
+  exchange( client, server );
+  for ( size_t i = 0; i < N; i++ ) {
+    TCPPeer& peer = client.peer( client_ids[i] );
+    expect( read_all( peer ) == to_string( 10000 + i ), "reply reaches the right connection" );
+    expect( peer.inbound_reader().is_finished(), "server closed" );
+    peer.outbound_writer().close();
+    client.push( client_ids[i] );
+  }
+  exchange( client, server );
+
+  // The server closed first, so it lingers in TIME_WAIT; the client is done right away.
+  client.tick( 1 );
+  expect( client.connection_count() == 0, "client connections are reaped" );
+  for ( unsigned int i = 0; i < 100 and server.connection_count() > 0; i++ ) {
+    server.tick( TCPConfig::TIMEOUT_DFLT );
+  }
+  expect( server.connection_count() == 0, "server connections are reaped after TIME_WAIT" );
+  expect( server.resets_sent() == 0 and client.resets_sent() == 0, "no resets" );
+
+  // The freed slots are reused by new connections.
+  const auto id = client.connect( client_flow( 10000 ), TCPConfig {} );
+  expect( id < N, "connection ids are reused" );
+  exchange( client, server );
+  expect( server.accept( SERVER_PORT ).has_value(), "new connection on a reused 4-tuple" );
+}
+
+void unknown_flows_are_reset()
+{
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+
+  // Nobody listens on the port: the SYN is answered with an RST.
+  const auto id = client.connect( client_flow( 5000 ), TCPConfig {} );
+  exchange( client, server );
+  expect( server.resets_sent() == 1, "RST for a SYN to a closed port" );
+  expect( server.connection_count() == 0, "no connection on the server" );
+  expect( not client.peer( id ).active() and client.peer( id ).inbound_reader().has_error(),
+          "client connection refused" );
+  client.tick( 1 );
+  expect( client.connection_count() == 0, "refused connection is reaped" );
+}
+
+void syn_backlog()
+{
+  constexpr size_t BACKLOG = 4;
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+  server.listen( SERVER_PORT, TCPConfig {}, BACKLOG );
+
+  for ( uint16_t i = 0; i < 2 * BACKLOG; i++ ) {
+    client.connect( client_flow( 20000 + i ), TCPConfig {} );
+  }
+  exchange( client, server );
+  expect( server.syns_dropped() == BACKLOG, "SYNs beyond the backlog are dropped" );
+  expect( server.connection_count() == BACKLOG, "only the backlog is admitted" );
+
+  // Accepting frees the queue; the dropped SYNs get in when they're retransmitted.
+  size_t accepted = 0;
+  for ( unsigned int i = 0; i < 20 and accepted < 2 * BACKLOG; i++ ) {
+    while ( server.accept( SERVER_PORT ) ) {
+      accepted++;
+    }
+    client.tick( TCPConfig::TIMEOUT_DFLT );
+    server.tick( TCPConfig::TIMEOUT_DFLT );
+    exchange( client, server );
+  }
+  expect( accepted == 2 * BACKLOG, "every connection is eventually accepted" );
+}
+
+// An in-order burst received in one batch reaches the peer as one segment, and is acknowledged once.
+void coalesces_bursts()
+{
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+  server.listen( SERVER_PORT, TCPConfig {} );
+  const auto id = client.connect( client_flow( 40000 ), TCPConfig {} );
+  exchange( client, server );
+  const auto accepted = server.accept( SERVER_PORT );
+  expect( accepted.has_value(), "connection accepted" );
+
+  const string data( 4 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' );
+  client.peer( id ).outbound_writer().push( data );
+  client.push( id );
+  size_t segments = 0;
+  while ( auto dgram = client.maybe_send() ) {
+    server.receive( over_the_wire( dgram.value() ) );
+    segments++;
+  }
+  expect( segments == 4, "four segments sent" );
+  server.end_batch();
+  expect( read_all( server.peer( accepted.value() ) ) == data, "all data delivered" );
+
+  size_t acks = 0;
+  while ( server.maybe_send() ) {
+    acks++;
+  }
+  expect( acks == 1, "one ACK for the burst, got " + to_string( acks ) );
+}
+
+// A connection reset while it waits in the accept queue is never handed out, even after its id is reused.
+void reset_before_accept()
+{
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+  server.listen( SERVER_PORT, TCPConfig {} );
+
+  const auto doomed = client.connect( client_flow( 30000 ), TCPConfig {} );
+  client.connect( client_flow( 30001 ), TCPConfig {} );
+  exchange( client, server );
+  expect( server.connection_count() == 2, "both connections are queued" );
+
+  client.peer( doomed ).abort();
+  client.push( doomed );
+  exchange( client, server );
+  server.tick( 1 );
+  expect( server.connection_count() == 1, "the reset connection is reaped" );
+
+  const auto accepted = server.accept( SERVER_PORT );
+  expect( accepted.has_value() and server.flow( accepted.value() ).remote_port == 30001,
+          "accept returns the surviving connection" );
+  expect( not server.accept( SERVER_PORT ).has_value(), "the reset connection is not accepted" );
+
+  // The freed id goes to the next connection, which is accepted exactly once
+  client.connect( client_flow( 30002 ), TCPConfig {} );
+  exchange( client, server );
+  const auto next = server.accept( SERVER_PORT );
+  expect( next.has_value() and server.flow( next.value() ).remote_port == 30002, "new connection is accepted" );
+  expect( not server.accept( SERVER_PORT ).has_value(), "and only once" );
+}
+
+// A listener keeps its queues across unlisten() and a later listen(), even with a handshake in progress.
+void relisten_with_half_open_connection()
+{
+  constexpr size_t BACKLOG = 2;
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+  server.listen( SERVER_PORT, TCPConfig {}, BACKLOG );
+
+  // The SYN reaches the server, but the handshake is not finished yet
+  const auto half_open = client.connect( client_flow( 50000 ), TCPConfig {} );
+  server.receive( over_the_wire( client.maybe_send().value() ) );
+  expect( server.connection_count() == 1, "the SYN creates a connection" );
+
+  server.unlisten( SERVER_PORT );
+  const auto refused = client.connect( client_flow( 50001 ), TCPConfig {} );
+  exchange( client, server );
+  expect( not client.has_connection( refused ) or not client.peer( refused ).active(), "new SYNs are reset" );
+  expect( server.accept( SERVER_PORT ).has_value(), "the handshake in progress still completes and is queued" );
+  expect( client.peer( half_open ).state() == TCPPeer::State::Established, "the client is connected" );
+
+  // Listen again while a second handshake is pending, then let it finish
+  server.listen( SERVER_PORT, TCPConfig {}, BACKLOG );
+  client.connect( client_flow( 50002 ), TCPConfig {} );
+  server.receive( over_the_wire( client.maybe_send().value() ) );
+  server.unlisten( SERVER_PORT );
+  server.listen( SERVER_PORT, TCPConfig {}, BACKLOG );
+  exchange( client, server );
+  expect( server.accept( SERVER_PORT ).has_value(), "the pending connection is accepted after the re-listen" );
+
+  // The SYN queue count survived: a full backlog of new connections still gets in
+  for ( uint16_t port = 50003; port < 50003 + BACKLOG; port++ ) {
+    client.connect( client_flow( port ), TCPConfig {} );
+  }
+  exchange( client, server );
+  for ( size_t i = 0; i < BACKLOG; i++ ) {
+    expect( server.accept( SERVER_PORT ).has_value(), "a new connection is accepted" );
+  }
+  expect( server.syns_dropped() == 0, "no SYN is dropped" );
+}
+
+// Only connections with something to do have a timer armed; idle ones catch up when they are next used.
+void idle_connections_have_no_timers()
+{
+  TCPConfig config;
+  config.delayed_ack_ms = 40;
+  TCPDemultiplexer client;
+  TCPDemultiplexer server;
+  server.listen( SERVER_PORT, config );
+
+  const auto id = client.connect( client_flow( 40000 ), config );
+  expect( client.armed_timers() == 1, "the SYN has a retransmission timer" );
+  exchange( client, server );
+  const auto accepted = server.accept( SERVER_PORT );
+  expect( accepted.has_value(), "connection is accepted" );
+  expect( client.armed_timers() == 0 and server.armed_timers() == 0, "an idle connection has no timer" );
+
+  // Data holds the client's retransmission timer and the server's delayed ACK
+  client.peer( id ).outbound_writer().push( "hello" );
+  client.push( id );
+  exchange( client, server );
+  expect( client.armed_timers() == 1 and server.armed_timers() == 1, "both sides are waiting for something" );
+  server.tick( config.delayed_ack_ms - 1 );
+  expect( not server.maybe_send().has_value(), "the ACK is held back" );
+  server.tick( 1 );
+  const auto ack = server.maybe_send();
+  expect( ack.has_value(), "the delayed ACK goes out when its timer fires" );
+  client.receive( over_the_wire( ack.value() ) );
+  expect( client.armed_timers() == 0 and server.armed_timers() == 0, "both sides are idle again" );
+
+  // A long idle stretch ticks nobody, and the connection still works afterwards
+  for ( int i = 0; i < 1000; i++ ) {
+    client.tick( TCPConfig::TIMEOUT_DFLT );
+    server.tick( TCPConfig::TIMEOUT_DFLT );
+  }
+  expect( not client.maybe_send().has_value() and not server.maybe_send().has_value(), "nothing is sent" );
+  server.peer( accepted.value() ).outbound_writer().push( "world" );
+  server.push( accepted.value() );
+  exchange( client, server );
+  expect( read_all( server.peer( accepted.value() ) ) == "hello", "the request arrived" );
+  expect( read_all( client.peer( id ) ) == "world", "the reply arrives after the idle stretch" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    many_connections();
+    unknown_flows_are_reset();
+    syn_backlog();
+    reset_before_accept();
+    coalesces_bursts();
+    relisten_with_half_open_connection();
+    idle_connections_have_no_timers();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
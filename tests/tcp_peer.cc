@@ -0,0 +1,254 @@
+#include "ipv4_header.hh"
+#include "random.hh"
+#include "tcp_peer.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+void expect_state( const TCPPeer& peer, TCPPeer::State state, const string& who )
+{
+  if ( peer.state() != state ) {
+    throw runtime_error( who + " should be in " + string( to_string( state ) ) + " but is in "
+                         + string( to_string( peer.state() ) ) );
+  }
+}
+
+// Carry a segment across the "wire": serialize it with a real header and checksum, then parse it back.
+TCPSegment over_the_wire( const TCPSegment& seg )
+{
+  TCPSegment copy = seg;
+  IPv4Header ip;
+  ip.len = IPv4Header::LENGTH + copy.header_length() + copy.sender_message.payload.size();
+  copy.compute_checksum( ip.pseudo_checksum() );
+  TCPSegment parsed;
+  Parser parser { serialize( copy ) };
+  parsed.parse( parser, ip.pseudo_checksum() );
+  expect( not parser.has_error(), "segment survives serialization" );
+  return parsed;
+}
+
+// Deliver everything each side has to send, until both are quiet. `drop` can discard segments.
+size_t exchange( TCPPeer& a, TCPPeer& b, const function<bool()>& drop = [] { return false; } )
+{
+  size_t delivered = 0;
+  bool progress = true;
+  while ( progress ) {
+    progress = false;
+    for ( auto [from, to] : { pair { &a, &b }, pair { &b, &a } } ) {
+      const vector<TCPSegment> segments = from->drain_outgoing();
+      for ( const auto& seg : segments ) {
+        progress = true;
+        if ( not drop() ) {
+          to->receive( over_the_wire( seg ) );
+          delivered++;
+        }
+      }
+    }
+  }
+  return delivered;
+}
+
+string read_all( TCPPeer& peer )
+{
+  string out;
+  while ( peer.inbound_reader().bytes_buffered() ) {
+    out.append( peer.inbound_reader().peek() );
+    peer.inbound_reader().pop( peer.inbound_reader().peek().size() );
+  }
+  return out;
+}
+
+TCPConfig config_with_rto( uint16_t rto )
+{
+  TCPConfig cfg;
+  cfg.rt_timeout = rto;
+  return cfg;
+}
+
+void handshake_transfer_and_close()
+{
+  TCPPeer a { config_with_rto( 100 ) };
+  TCPPeer b { config_with_rto( 100 ) };
+  expect_state( a, TCPPeer::State::Listen, "a" );
+  a.connect();
+  expect_state( a, TCPPeer::State::SynSent, "a" );
+  const auto& syn = a.drain_outgoing();
+  expect( syn.size() == 1 and syn[0].sender_message.SYN and syn[0].mss.has_value(), "SYN with MSS option" );
+  b.receive( over_the_wire( syn[0] ) );
+  expect_state( b, TCPPeer::State::SynReceived, "b" );
+  exchange( a, b );
+  expect_state( a, TCPPeer::State::Established, "a" );
+  expect_state( b, TCPPeer::State::Established, "b" );
+
+  a.outbound_writer().push( "hello from a" );
+  a.push();
+  b.outbound_writer().push( "hello from b" );
+  b.push();
+  exchange( a, b );
+  expect( read_all( b ) == "hello from a", "a -> b data" );
+  expect( read_all( a ) == "hello from b", "b -> a data" );
+
+  // a closes first (active close)
+  a.outbound_writer().close();
+  a.push();
+  expect_state( a, TCPPeer::State::FinWait1, "a" );
+  exchange( a, b );
+  expect_state( a, TCPPeer::State::FinWait2, "a" );
+  expect_state( b, TCPPeer::State::CloseWait, "b" );
+  expect( b.inbound_reader().is_finished(), "b's inbound stream finished" );
+
+  b.outbound_writer().close();
+  b.push();
+  expect_state( b, TCPPeer::State::LastAck, "b" );
+  exchange( a, b );
+  expect_state( a, TCPPeer::State::TimeWait, "a" );
+  expect_state( b, TCPPeer::State::Closed, "b" );
+  expect( not b.inbound_reader().has_error(), "clean close" );
+
+  a.tick( 999 );
+  expect_state( a, TCPPeer::State::TimeWait, "a" );
+  a.tick( 1 );
+  expect_state( a, TCPPeer::State::Closed, "a" );
+  expect( not a.inbound_reader().has_error(), "clean close" );
+}
+
+void simultaneous_close()
+{
+  TCPPeer a { config_with_rto( 100 ) };
+  TCPPeer b { config_with_rto( 100 ) };
+  a.connect();
+  exchange( a, b );
+  a.outbound_writer().close();
+  a.push();
+  b.outbound_writer().close();
+  b.push();
+  exchange( a, b );
+  // both sent their FIN before seeing the other's: both linger
+  expect_state( a, TCPPeer::State::TimeWait, "a" );
+  expect_state( b, TCPPeer::State::TimeWait, "b" );
+  a.tick( 1000 );
+  b.tick( 1000 );
+  expect( not a.active() and not b.active(), "both closed" );
+}
+
+void reset_handling()
+{
+  TCPPeer a { config_with_rto( 100 ) };
+  TCPPeer b { config_with_rto( 100 ) };
+  a.connect();
+  exchange( a, b );
+  a.abort();
+  expect_state( a, TCPPeer::State::Closed, "a" );
+  const auto& rst = a.drain_outgoing();
+  expect( rst.size() == 1 and rst[0].RST, "abort sends RST" );
+
+  // an RST with the wrong sequence number is ignored
+  TCPSegment bogus = rst[0];
+  bogus.sender_message.seqno = bogus.sender_message.seqno + 1000;
+  b.receive( over_the_wire( bogus ) );
+  expect_state( b, TCPPeer::State::Established, "b" );
+
+  b.receive( over_the_wire( rst[0] ) );
+  expect_state( b, TCPPeer::State::Closed, "b" );
+  expect( b.inbound_reader().has_error(), "RST puts the stream in the error state" );
+
+  // a listening peer answers a stray ACK with an RST
+  TCPPeer listener { config_with_rto( 100 ) };
+  TCPSegment stray;
+  stray.sender_message.seqno = Wrap32 { 5 };
+  stray.receiver_message.ackno = Wrap32 { 77 };
+  listener.receive( stray );
+  const auto& reply = listener.drain_outgoing();
+  expect( reply.size() == 1 and reply[0].RST and reply[0].sender_message.seqno == Wrap32 { 77 }, "RST reply" );
+  expect_state( listener, TCPPeer::State::Listen, "listener" );
+}
+
+void gives_up_after_retransmissions()
+{
+  TCPPeer a { config_with_rto( 10 ) };
+  a.connect();
+  size_t syns = 0;
+  for ( unsigned int i = 0; i < 100000 and a.active(); i++ ) {
+    a.tick( 1 );
+    for ( const auto& seg : a.drain_outgoing() ) {
+      syns += seg.sender_message.SYN;
+      if ( seg.RST ) {
+        expect( not a.active(), "RST sent when giving up" );
+      }
+    }
+  }
+  expect( not a.active(), "connection aborted" );
+  expect( syns == 1 + TCPConfig::MAX_RETX_ATTEMPTS,
+          "SYN retransmitted the maximum number of times, got " + to_string( syns ) );
+  expect( a.inbound_reader().has_error(), "error reported" );
+}
+
+void lossy_bulk_transfer( default_random_engine& rd )
+{
+  TCPConfig cfg = config_with_rto( 50 );
+  cfg.delayed_ack_ms = 10;
+  cfg.window_scale = TCPConfig::window_scale_for( 200000 );
+  cfg.recv_capacity = 200000;
+  TCPPeer a { cfg };
+  TCPPeer b { cfg };
+
+  string data( 300000, 0 );
+  for ( auto& c : data ) {
+    c = static_cast<char>( rd() );
+  }
+
+  auto drop = [&] { return uniform_int_distribution<int> { 0, 9 }( rd ) == 0; };
+  a.connect();
+  size_t written = 0;
+  string received;
+  for ( unsigned int i = 0; i < 100000 and received.size() < data.size(); i++ ) {
+    const auto chunk = data.substr( written, a.outbound_writer().available_capacity() );
+    a.outbound_writer().push( chunk );
+    written += chunk.size();
+    a.push();
+    exchange( a, b, drop );
+    received += read_all( b );
+    b.push();
+    a.tick( 5 );
+    b.tick( 5 );
+  }
+  expect( received == data, "bulk data arrives intact despite loss" );
+  expect( a.sender().window_size() > 65535 and b.sender().window_size() > 65535,
+          "the peers see each other's scaled windows" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    handshake_transfer_and_close();
+    simultaneous_close();
+    reset_handling();
+    gives_up_after_retransmissions();
+    lossy_bulk_transfer( rd );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
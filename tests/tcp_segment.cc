@@ -0,0 +1,176 @@
+#include "ipv4_header.hh"
+#include "parser.hh"
+#include "random.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+string flatten( const vector<Buffer>& buffers )
+{
+  string out;
+  for ( const auto& b : buffers ) {
+    out.append( string_view { b } );
+  }
+  return out;
+}
+
+// Cut a byte string into pieces of random (often odd) sizes, as a scatter-gather read might return it
+vector<Buffer> scatter( const string& bytes, default_random_engine& rd )
+{
+  vector<Buffer> out;
+  for ( size_t i = 0; i < bytes.size(); ) {
+    const size_t len = uniform_int_distribution<size_t> { 1, 7 }( rd );
+    out.emplace_back( bytes.substr( i, len ) );
+    i += len;
+  }
+  return out;
+}
+
+// Straightforward RFC 1071 checksum over the pseudo-header and a flat copy of the segment
+uint16_t reference_checksum( const IPv4Header& ip, const string& segment )
+{
+  uint64_t sum = ( ip.src >> 16 ) + ( ip.src & 0xffff ) + ( ip.dst >> 16 ) + ( ip.dst & 0xffff ) + ip.proto
+                 + segment.size();
+  for ( size_t i = 0; i < segment.size(); i += 2 ) {
+    const uint16_t hi = static_cast<uint8_t>( segment[i] );
+    const uint16_t lo = i + 1 < segment.size() ? static_cast<uint8_t>( segment[i + 1] ) : 0;
+    sum += hi << 8 | lo;
+  }
+  while ( sum > 0xffff ) {
+    sum = ( sum >> 16 ) + ( sum & 0xffff );
+  }
+  return ~static_cast<uint16_t>( sum );
+}
+
+IPv4Header ip_header_for( const TCPSegment& seg )
+{
+  IPv4Header ip;
+  ip.src = 0x0a000001;
+  ip.dst = 0xc0a80102;
+  ip.len = IPv4Header::LENGTH + seg.header_length() + seg.sender_message.payload.size();
+  return ip;
+}
+
+void roundtrip( default_random_engine& rd )
+{
+  for ( unsigned int i = 0; i < 200; i++ ) {
+    TCPSegment seg;
+    seg.sport = rd();
+    seg.dport = rd();
+    seg.sender_message.seqno = Wrap32 { static_cast<uint32_t>( rd() ) };
+    seg.sender_message.SYN = i % 3 == 0;
+    seg.sender_message.FIN = i % 5 == 0;
+    seg.RST = i % 7 == 0;
+    if ( seg.sender_message.SYN ) {
+      seg.mss = 1460;
+      if ( i % 2 ) {
+        seg.sender_message.window_scale = i % 15;
+      }
+    }
+    if ( i % 4 ) {
+      seg.receiver_message.ackno = Wrap32 { static_cast<uint32_t>( rd() ) };
+    }
+    seg.receiver_message.window_size = rd();
+    string payload( uniform_int_distribution<size_t> { 0, 1500 }( rd ), 0 );
+    for ( auto& c : payload ) {
+      c = static_cast<char>( rd() );
+    }
+    seg.sender_message.payload = payload;
+
+    const IPv4Header ip = ip_header_for( seg );
+    seg.compute_checksum( ip.pseudo_checksum() );
+
+    const string wire = flatten( serialize( seg ) );
+    expect( wire.size() == seg.header_length() + payload.size(), "serialized length" );
+    expect( reference_checksum( ip, wire ) == 0, "checksum verifies against a flat reference implementation" );
+
+    TCPSegment parsed;
+    Parser parser { scatter( wire, rd ) };
+    parsed.parse( parser, ip.pseudo_checksum() );
+    expect( not parser.has_error(), "parsed without error" );
+    expect( parsed.sport == seg.sport and parsed.dport == seg.dport, "ports" );
+    expect( parsed.sender_message.seqno == seg.sender_message.seqno, "seqno" );
+    expect( parsed.sender_message.SYN == seg.sender_message.SYN, "SYN" );
+    expect( parsed.sender_message.FIN == seg.sender_message.FIN, "FIN" );
+    expect( parsed.RST == seg.RST, "RST" );
+    expect( parsed.receiver_message.ackno == seg.receiver_message.ackno, "ackno" );
+    expect( parsed.receiver_message.window_size == seg.receiver_message.window_size, "window" );
+    expect( parsed.mss == seg.mss, "MSS option" );
+    expect( parsed.sender_message.window_scale == seg.sender_message.window_scale, "window scale option" );
+    expect( string_view { parsed.sender_message.payload } == payload, "payload" );
+  }
+}
+
+void detects_corruption()
+{
+  TCPSegment seg;
+  seg.sport = 1234;
+  seg.dport = 80;
+  seg.sender_message.seqno = Wrap32 { 42 };
+  seg.sender_message.payload = string( "hello, world" );
+  seg.receiver_message.ackno = Wrap32 { 99 };
+  seg.receiver_message.window_size = 1000;
+  const IPv4Header ip = ip_header_for( seg );
+  seg.compute_checksum( ip.pseudo_checksum() );
+
+  string wire = flatten( serialize( seg ) );
+  wire.back() ^= 1;
+  TCPSegment parsed;
+  Parser parser { vector<Buffer> { wire } };
+  parsed.parse( parser, ip.pseudo_checksum() );
+  expect( parser.has_error(), "corrupted payload is rejected" );
+
+  Parser wrong_pseudo { serialize( seg ) };
+  parsed.parse( wrong_pseudo, ip.pseudo_checksum() + 1 );
+  expect( wrong_pseudo.has_error(), "checksum covers the pseudo-header" );
+
+  Parser truncated { vector<Buffer> { flatten( serialize( seg ) ).substr( 0, 12 ) } };
+  parsed.parse( truncated, ip.pseudo_checksum() );
+  expect( truncated.has_error(), "truncated header is rejected" );
+}
+
+void payload_is_not_copied()
+{
+  TCPSegment seg;
+  seg.sender_message.payload = string( 1000, 'x' );
+  const auto buffers = serialize( seg );
+  bool shared = false;
+  for ( const auto& b : buffers ) {
+    shared |= string_view { b }.data() == string_view { seg.sender_message.payload }.data();
+  }
+  expect( shared, "payload buffer is shared, not copied" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+    roundtrip( rd );
+    detects_corruption();
+    payload_is_not_copied();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
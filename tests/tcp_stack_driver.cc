@@ -0,0 +1,171 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "tcp_stack_driver.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t CLIENT_ADDRESS = 0x0a000001; // 10.0.0.1
+constexpr uint32_t SERVER_ADDRESS = 0x0a000002; // 10.0.0.2
+constexpr uint16_t SERVER_PORT = 80;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+// A pair of connected descriptors that keep message boundaries, like a TUN device.
+pair<FileDescriptor, FileDescriptor> datagram_pair()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", socketpair( AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
+void loop_runs_callbacks()
+{
+  EventLoop loop;
+  auto [reader, writer] = datagram_pair();
+
+  string received;
+  loop.add_rule( reader, EventLoop::Direction::In, [&] {
+    string buf;
+    reader.read( buf );
+    received += buf;
+  } );
+  uint64_t elapsed = 0;
+  loop.add_timer( 5, [&]( uint64_t ms ) { elapsed += ms; } );
+
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, "nothing to do yet" );
+  writer.write( "hello" );
+  expect( loop.wait_next_event( 1000 ) == EventLoop::Result::Success, "readable" );
+  expect( received == "hello", "callback ran" );
+
+  while ( elapsed < 20 ) {
+    loop.wait_next_event( 1000 );
+  }
+  expect( elapsed % 5 == 0, "timer reports whole periods" );
+
+  // Closing the writer makes the reader hit EOF, which cancels its rule; the timer alone doesn't
+  // keep the loop running.
+  writer.close();
+  loop.wait_next_event( 1000 );
+  expect( reader.eof(), "EOF seen" );
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Exit, "loop exits when nothing is interesting" );
+}
+
+void interest_controls_registration()
+{
+  EventLoop loop;
+  auto [a, b] = datagram_pair();
+  bool want_write = false;
+  unsigned int writes = 0;
+  loop.add_rule(
+    a, EventLoop::Direction::Out, [&] { writes++; }, [&] { return want_write; } );
+  loop.add_rule( a, EventLoop::Direction::In, [&] {} );
+
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout, "uninterested rule doesn't fire" );
+  want_write = true;
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Success and writes == 1, "interested rule fires" );
+  want_write = false;
+  expect( loop.wait_next_event( 0 ) == EventLoop::Result::Timeout and writes == 1, "and stops again" );
+}
+
+void stack_over_a_device()
+{
+  EventLoop loop;
+  auto [client_end, server_end] = datagram_pair();
+  TCPStackDriver client { move( client_end ), loop, 1 };
+  TCPStackDriver server { move( server_end ), loop, 2 };
+
+  constexpr size_t N = 50;
+  server.demux().listen( SERVER_PORT, TCPConfig {} );
+  vector<TCPDemultiplexer::ConnectionId> ids;
+  for ( uint16_t i = 0; i < N; i++ ) {
+    ids.push_back( client.demux().connect( { CLIENT_ADDRESS, SERVER_ADDRESS, uint16_t( 30000 + i ), SERVER_PORT },
+                                           TCPConfig {} ) );
+  }
+  client.flush();
+
+  // Echo server: every accepted connection sends back what it reads, then closes when the client does.
+  vector<TCPDemultiplexer::ConnectionId> accepted;
+  vector<string> replies( N );
+  size_t finished = 0;
+  for ( unsigned int round = 0; round < 10000 and finished < N; round++ ) {
+    loop.wait_next_event( 100 );
+
+    while ( auto id = server.demux().accept( SERVER_PORT ) ) {
+      accepted.push_back( id.value() );
+    }
+    erase_if( accepted, [&]( auto id ) { return not server.demux().has_connection( id ); } );
+    for ( const auto id : accepted ) {
+      TCPPeer& peer = server.demux().peer( id );
+      if ( not peer.active() or peer.outbound_writer().is_closed() ) {
+        continue;
+      }
+      Reader& in = peer.inbound_reader();
+      while ( in.bytes_buffered() ) {
+        peer.outbound_writer().push( string( in.peek() ) );
+        in.pop( in.peek().size() );
+      }
+      if ( in.is_finished() ) {
+        peer.outbound_writer().close();
+      }
+      server.demux().push( id );
+    }
+    server.flush();
+
+    finished = 0;
+    for ( size_t i = 0; i < N; i++ ) {
+      TCPPeer& peer = client.demux().peer( ids[i] ); // the client closes first, so it lingers in TIME_WAIT
+      if ( peer.state() == TCPPeer::State::Established and peer.outbound_writer().bytes_pushed() == 0 ) {
+        peer.outbound_writer().push( "request " + to_string( i ) );
+        peer.outbound_writer().close();
+        client.demux().push( ids[i] );
+      }
+      Reader& in = peer.inbound_reader();
+      while ( in.bytes_buffered() ) {
+        replies[i] += in.peek();
+        in.pop( in.peek().size() );
+      }
+      finished += in.is_finished();
+    }
+    client.flush();
+  }
+
+  expect( finished == N, "every connection got its echo" );
+  for ( size_t i = 0; i < N; i++ ) {
+    expect( replies[i] == "request " + to_string( i ), "echo matches the request" );
+  }
+  expect( server.read_batches() < server.datagrams_received(), "datagrams are read in batches" );
+  expect( client.datagrams_dropped() == 0 and server.datagrams_dropped() == 0, "nothing dropped" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    loop_runs_callbacks();
+    interest_controls_registration();
+    stack_over_a_device();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include "tcp_sender.hh"
+#include "timer_wheel.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "expectation failed: " + what );
+  }
+}
+
+// Advance the wheel one millisecond at a time, recording when each key fired.
+map<uint64_t, uint64_t> run( TimerWheel& wheel, uint64_t ms )
+{
+  map<uint64_t, uint64_t> fired;
+  for ( uint64_t i = 0; i < ms; i++ ) {
+    wheel.tick( 1, [&]( uint64_t key ) {
+      expect( not fired.contains( key ), "timer " + to_string( key ) + " fired twice" );
+      fired[key] = wheel.now();
+    } );
+  }
+  return fired;
+}
+
+void deadlines_at_every_level()
+{
+  TimerWheel wheel;
+  const vector<uint64_t> deadlines { 1, 5, 63, 64, 65, 4095, 4096, 4100, 262143, 262145, 300000 };
+  for ( const auto d : deadlines ) {
+    wheel.arm( wheel.add_timer( d ), d );
+  }
+  expect( wheel.armed_count() == deadlines.size(), "all timers armed" );
+
+  const auto fired = run( wheel, 300000 );
+  for ( const auto d : deadlines ) {
+    expect( fired.contains( d ), "timer " + to_string( d ) + " fired" );
+    expect( fired.at( d ) == d, "timer " + to_string( d ) + " fired at " + to_string( fired.at( d ) ) );
+  }
+  expect( wheel.armed_count() == 0, "no timers left armed" );
+}
+
+void rearm_and_disarm()
+{
+  TimerWheel wheel;
+  const auto a = wheel.add_timer( 1 );
+  const auto b = wheel.add_timer( 2 );
+  wheel.arm( a, 100 );
+  wheel.arm( b, 100 );
+  wheel.arm( a, 5000 ); // pushed back
+  wheel.disarm( b );
+
+  auto fired = run( wheel, 4999 );
+  expect( fired.empty(), "nothing fires before the new deadline" );
+  fired = run( wheel, 1 );
+  expect( fired.size() == 1 and fired.at( 1 ) == 5000, "re-armed timer fires at its new deadline" );
+
+  // a deadline in the past fires on the next tick
+  wheel.arm( b, 10 );
+  uint64_t count = 0;
+  wheel.tick( 7, [&]( uint64_t key ) {
+    expect( key == 2, "overdue timer reported" );
+    count++;
+  } );
+  expect( count == 1, "overdue timer fires once" );
+
+  // a large tick fires everything that came due
+  wheel.arm( a, wheel.now() + 70000 );
+  wheel.arm( b, wheel.now() + 3 );
+  count = 0;
+  wheel.tick( 100000, [&]( uint64_t ) { count++; } );
+  expect( count == 2, "large tick fires both timers" );
+}
+
+void shared_by_senders()
+{
+  constexpr uint64_t rto = 1000;
+  constexpr size_t n = 1000;
+
+  TimerWheel wheel;
+  vector<TCPSender> senders;
+  vector<ByteStream> streams;
+  senders.reserve( n );
+  streams.reserve( n );
+  for ( size_t i = 0; i < n; i++ ) {
+    senders.emplace_back( rto, Wrap32 { 0 } );
+    streams.emplace_back( 1000 );
+    senders.back().attach_timer_wheel( wheel, i );
+  }
+
+  // only the even senders have a SYN in flight
+  for ( size_t i = 0; i < n; i += 2 ) {
+    senders[i].push( streams[i].reader() );
+    expect( senders[i].maybe_send().has_value(), "SYN sent" );
+  }
+  expect( wheel.armed_count() == n / 2, "one armed timer per sender with data in flight" );
+
+  vector<uint64_t> expired;
+  const auto on_expired = [&]( uint64_t key ) {
+    expired.push_back( key );
+    senders.at( key ).timer_expired();
+  };
+
+  wheel.tick( rto - 1, on_expired );
+  expect( expired.empty(), "no timer expires before the RTO" );
+  wheel.tick( 1, on_expired );
+  expect( expired.size() == n / 2, "every sender with data in flight timed out" );
+  for ( const auto key : expired ) {
+    expect( key % 2 == 0, "only senders with data in flight time out" );
+    expect( senders[key].consecutive_retransmissions() == 1, "retransmission counted" );
+    const auto msg = senders[key].maybe_send();
+    expect( msg.has_value() and msg->SYN, "SYN retransmitted" );
+  }
+
+  // the RTO doubles, and an ACK stops the timer
+  senders[0].receive( { Wrap32 { 1 }, 1000 } );
+  expired.clear();
+  wheel.tick( 2 * rto - 1, on_expired );
+  expect( expired.empty(), "backed-off RTO has not expired yet" );
+  wheel.tick( 1, on_expired );
+  expect( expired.size() == n / 2 - 1, "the acked sender's timer was disarmed" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    deadlines_at_every_level();
+    rearm_and_disarm();
+    shared_by_senders();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
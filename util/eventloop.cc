@@ -0,0 +1,118 @@
+#include "eventloop.hh"
+#include "exception.hh"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+EventLoop::EventLoop() : epoll_fd_( CheckSystemCall( "epoll_create1", epoll_create1( EPOLL_CLOEXEC ) ) ) {}
+
+void EventLoop::add_rule( const FileDescriptor& fd,
+                          Direction direction,
+                          const CallbackT& callback,
+                          const InterestT& interest )
+{
+  rules_for( fd ).rules.push_back( { direction, callback, interest } );
+}
+
+void EventLoop::add_timer( uint64_t period_ms, const TimerCallbackT& callback )
+{
+  FileDescriptor timer { CheckSystemCall( "timerfd_create",
+                                          timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ) ) };
+  const timespec period { static_cast<time_t>( period_ms / 1000 ), static_cast<long>( period_ms % 1000 * 1000000 ) };
+  const itimerspec spec { period, period };
+  CheckSystemCall( "timerfd_settime", timerfd_settime( timer.fd_num(), 0, &spec, nullptr ) );
+
+  // 读出到期的次数 (可能不止一次, 如果loop在忙别的事情)
+  const int timer_fd = timer.fd_num();
+  add_rule( timer, Direction::In, [timer_fd, period_ms, callback] {
+    uint64_t expirations = 0;
+    if ( ::read( timer_fd, &expirations, sizeof( expirations ) ) == sizeof( expirations ) ) {
+      callback( expirations * period_ms );
+    }
+  } );
+  rules_for( timer ).is_timer = true;
+}
+
+EventLoop::FDRules& EventLoop::rules_for( const FileDescriptor& fd )
+{
+  auto& entry = fds_[fd.fd_num()];
+  if ( not entry ) {
+    entry = make_unique<FDRules>( FDRules { fd.duplicate() } );
+  }
+  return *entry;
+}
+
+// 根据当前的interest更新epoll的注册, 返回这个fd是否还有任何interest
+bool EventLoop::update_registration( FDRules& entry )
+{
+  uint32_t events = 0;
+  for ( const auto& rule : entry.rules ) {
+    if ( rule.interest() ) {
+      events |= static_cast<uint32_t>( rule.direction );
+    }
+  }
+  if ( events == entry.registered_events ) {
+    return events != 0;
+  }
+
+  epoll_event event {};
+  event.events = events;
+  event.data.ptr = &entry;
+  if ( entry.registered_events == 0 ) {
+    CheckSystemCall( "epoll_ctl", epoll_ctl( epoll_fd_.fd_num(), EPOLL_CTL_ADD, entry.fd.fd_num(), &event ) );
+  } else if ( events == 0 ) {
+    CheckSystemCall( "epoll_ctl", epoll_ctl( epoll_fd_.fd_num(), EPOLL_CTL_DEL, entry.fd.fd_num(), nullptr ) );
+  } else {
+    CheckSystemCall( "epoll_ctl", epoll_ctl( epoll_fd_.fd_num(), EPOLL_CTL_MOD, entry.fd.fd_num(), &event ) );
+  }
+  entry.registered_events = events;
+  return events != 0;
+}
+
+EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
+{
+  // 删除已经结束的fd, 并更新其他fd的interest
+  bool any_interest = false;
+  for ( auto it = fds_.begin(); it != fds_.end(); ) {
+    FDRules& entry = *it->second;
+    if ( entry.fd.eof() or entry.fd.closed() ) {
+      if ( entry.registered_events != 0 and not entry.fd.closed() ) {
+        CheckSystemCall( "epoll_ctl", epoll_ctl( epoll_fd_.fd_num(), EPOLL_CTL_DEL, entry.fd.fd_num(), nullptr ) );
+      }
+      it = fds_.erase( it );
+      continue;
+    }
+    // 定时器本身不算"interest", 否则只有定时器的loop永远不会退出
+    const bool interested = update_registration( entry );
+    any_interest |= interested and not entry.is_timer;
+    ++it;
+  }
+  if ( not any_interest ) {
+    return Result::Exit;
+  }
+
+  const int ready
+    = CheckSystemCall( "epoll_wait", epoll_wait( epoll_fd_.fd_num(), events_.data(), MAX_EVENTS, timeout_ms ) );
+  if ( ready == 0 ) {
+    return Result::Timeout;
+  }
+
+  for ( int i = 0; i < ready; i++ ) {
+    auto& entry = *static_cast<FDRules*>( events_[i].data.ptr );
+    const uint32_t revents = events_[i].events;
+    for ( size_t j = 0; j < entry.rules.size(); j++ ) {
+      const auto direction = static_cast<uint32_t>( entry.rules[j].direction );
+      // 出错或挂断时也调用callback, 让它读到EOF或错误
+      if ( ( revents & ( direction | EPOLLERR | EPOLLHUP ) ) and ( entry.registered_events & direction )
+           and entry.rules[j].interest() ) {
+        // 复制一份: callback可能会给同一个fd添加新的rule
+        const auto callback = entry.rules[j].callback;
+        callback();
+        events_serviced_++;
+      }
+    }
+  }
+  return Result::Success;
+}
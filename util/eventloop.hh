@@ -0,0 +1,83 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
+
+//! Waits for events on file descriptors and timers and executes corresponding callbacks.
+//! \details Built on [epoll(7)](\ref man7::epoll): each file descriptor is registered once, and its event
+//! mask is updated only when a rule's interest changes, so an iteration costs O(ready fds) in the kernel.
+//! Timers are [timerfd(2)](\ref man2::timerfd_create) descriptors serviced by the same epoll instance.
+class EventLoop
+{
+public:
+  //! Indicates interest in reading (In) or writing (Out) a polled fd.
+  enum class Direction : uint32_t
+  {
+    In = EPOLLIN,  //!< Callback will be triggered when fd is readable.
+    Out = EPOLLOUT //!< Callback will be triggered when fd is writable.
+  };
+
+  //! Returned by each call to EventLoop::wait_next_event.
+  enum class Result
+  {
+    Success, //!< At least one rule was triggered.
+    Timeout, //!< No rules were triggered before timeout.
+    Exit     //!< All rules have been canceled or were uninterested; make no further calls to wait_next_event.
+  };
+
+  using CallbackT = std::function<void()>;
+  using InterestT = std::function<bool()>;
+  using TimerCallbackT = std::function<void( uint64_t )>; //!< called with the elapsed time in milliseconds
+
+  EventLoop();
+
+  //! Call `callback` whenever `fd` is ready in the given direction and `interest` returns true.
+  //! The rule is cancelled once `fd` reaches EOF or is closed.
+  void add_rule( const FileDescriptor& fd,
+                 Direction direction,
+                 const CallbackT& callback,
+                 const InterestT& interest = [] { return true; } );
+
+  //! Call `callback` every `period_ms` milliseconds. Expirations missed while the loop was busy
+  //! are coalesced into one call with the total elapsed time.
+  void add_timer( uint64_t period_ms, const TimerCallbackT& callback );
+
+  //! Wait for at most `timeout_ms` milliseconds (-1 to wait forever) and run the triggered callbacks.
+  Result wait_next_event( int timeout_ms );
+
+  //! Number of events serviced so far (for statistics)
+  uint64_t events_serviced() const { return events_serviced_; }
+
+private:
+  static constexpr int MAX_EVENTS = 64;
+
+  struct Rule
+  {
+    Direction direction;
+    CallbackT callback;
+    InterestT interest;
+  };
+
+  // All the rules for one file descriptor (epoll allows a single registration per fd)
+  struct FDRules
+  {
+    FileDescriptor fd;
+    std::vector<Rule> rules {};
+    uint32_t registered_events {};
+    bool is_timer {}; // timers alone don't keep the loop running
+  };
+
+  FileDescriptor epoll_fd_;
+  std::unordered_map<int, std::unique_ptr<FDRules>> fds_ {};
+  std::vector<epoll_event> events_ = std::vector<epoll_event>( MAX_EVENTS );
+  uint64_t events_serviced_ {};
+
+  FDRules& rules_for( const FileDescriptor& fd );
+  bool update_registration( FDRules& entry );
+};
@@ -36,6 +36,11 @@ T FileDescriptor::CheckSystemCall( std::string_view s_attempt, T return_value )
   return internal_fd_->CheckSystemCall( s_attempt, return_value );
 }
 
+// CheckSystemCall is defined only in this file but is called from other translation units (Socket, TunTapFD,
+// EventLoop), so instantiate it explicitly rather than rely on implicit instantiations that may be inlined away
+template int FileDescriptor::CheckSystemCall( std::string_view, int ) const;
+template ssize_t FileDescriptor::CheckSystemCall( std::string_view, ssize_t ) const;
+
 // fd is the file descriptor number returned by [open(2)](\ref man2::open) or similar
 FileDescriptor::FDWrapper::FDWrapper( int fd ) : fd_( fd )
 {
@@ -169,7 +174,8 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
     = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
   register_write();
 
-  if ( bytes_written == 0 and total_size != 0 ) {
+  // a non-blocking fd that isn't ready returns 0 (see CheckSystemCall); the caller can retry later
+  if ( bytes_written == 0 and total_size != 0 and not internal_fd_->non_blocking_ ) {
     throw runtime_error( "write returned 0 given non-empty input buffer" );
   }
 
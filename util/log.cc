@@ -0,0 +1,101 @@
+#include "log.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+string_view to_string( LogLevel level )
+{
+  switch ( level ) {
+    case LogLevel::Trace:
+      return "TRACE";
+    case LogLevel::Debug:
+      return "DEBUG";
+    case LogLevel::Info:
+      return "INFO";
+    case LogLevel::Warn:
+      return "WARN";
+    case LogLevel::Error:
+      return "ERROR";
+    case LogLevel::Off:
+      break;
+  }
+  return "OFF";
+}
+
+LogRing::LogRing( size_t capacity )
+  : mask_( bit_ceil( max( capacity, size_t { 2 } ) ) - 1 ), slots_( make_unique<Slot[]>( mask_ + 1 ) )
+{
+  // slot i is free for the producer whose position is i
+  for ( size_t i = 0; i <= mask_; i++ ) {
+    slots_[i].sequence.store( i, memory_order_relaxed );
+  }
+}
+
+bool LogRing::push( LogLevel level, string_view message )
+{
+  size_t position = enqueue_position_.load( memory_order_relaxed );
+  Slot* slot {};
+  while ( true ) {
+    slot = &slots_[position & mask_];
+    const size_t sequence = slot->sequence.load( memory_order_acquire );
+    const auto lap = static_cast<intptr_t>( sequence ) - static_cast<intptr_t>( position );
+    if ( lap == 0 ) {
+      if ( enqueue_position_.compare_exchange_weak( position, position + 1, memory_order_relaxed ) ) {
+        break;
+      }
+    } else if ( lap < 0 ) {
+      // the consumer has not freed this slot yet: the ring is full
+      dropped_.fetch_add( 1, memory_order_relaxed );
+      return false;
+    } else {
+      position = enqueue_position_.load( memory_order_relaxed );
+    }
+  }
+
+  slot->level = level;
+  slot->length = static_cast<uint8_t>( min( message.size(), MAX_MESSAGE ) );
+  copy_n( message.data(), slot->length, slot->text.data() );
+  slot->sequence.store( position + 1, memory_order_release );
+  return true;
+}
+
+size_t LogRing::drain( const function<void( LogLevel level, string_view message )>& consumer )
+{
+  size_t count = 0;
+  size_t position = dequeue_position_.load( memory_order_relaxed );
+  while ( true ) {
+    Slot* slot = &slots_[position & mask_];
+    const size_t sequence = slot->sequence.load( memory_order_acquire );
+    const auto lap = static_cast<intptr_t>( sequence ) - static_cast<intptr_t>( position + 1 );
+    if ( lap == 0 ) {
+      if ( dequeue_position_.compare_exchange_weak( position, position + 1, memory_order_relaxed ) ) {
+        consumer( slot->level, { slot->text.data(), slot->length } );
+        // free the slot for the producer one lap later
+        slot->sequence.store( position + mask_ + 1, memory_order_release );
+        count++;
+        position++;
+      }
+    } else if ( lap < 0 ) {
+      return count; // empty (or the next record is still being written)
+    } else {
+      position = dequeue_position_.load( memory_order_relaxed );
+    }
+  }
+}
+
+LogRing& LogRing::global()
+{
+  static LogRing ring { 4096 };
+  return ring;
+}
+
+void Log::flush()
+{
+  LogRing::global().drain( []( LogLevel level, string_view message ) {
+    cerr << to_string( level ) << ": " << message << "\n";
+  } );
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+//! Severity of a log message, from the most verbose to the least
+enum class LogLevel : uint8_t
+{
+  Trace, //!< per-packet detail
+  Debug, //!< per-object events (an interface created, a route added)
+  Info,
+  Warn,
+  Error,
+  Off //!< compile every message out
+};
+
+std::string_view to_string( LogLevel level );
+
+// The level is fixed at compile time (the build sets MINNOW_LOG_LEVEL, see etc/cflags.cmake).
+#ifndef MINNOW_LOG_LEVEL
+#ifdef NDEBUG
+#define MINNOW_LOG_LEVEL Warn
+#else
+#define MINNOW_LOG_LEVEL Trace
+#endif
+#endif
+
+//! Messages below this level are compiled out
+inline constexpr LogLevel COMPILED_LOG_LEVEL = LogLevel::MINNOW_LOG_LEVEL;
+
+//! \brief A bounded, lock-free, multi-producer multi-consumer queue of log records.
+//! \details Each slot carries a sequence number saying whether it is free or full for the current lap
+//! (Vyukov's bounded queue), so producers and consumers only ever CAS a position counter. A producer
+//! never waits: when the ring is full the record is dropped and counted instead.
+class LogRing
+{
+public:
+  static constexpr size_t MAX_MESSAGE = 240; //!< longer messages are truncated
+
+  //! A ring of `capacity` records (rounded up to a power of two)
+  explicit LogRing( size_t capacity );
+
+  //! Append a record; returns false (and counts a drop) if the ring is full
+  bool push( LogLevel level, std::string_view message );
+
+  //! Remove every record currently in the ring, oldest first, passing each to `consumer`;
+  //! returns the number of records removed
+  size_t drain( const std::function<void( LogLevel level, std::string_view message )>& consumer );
+
+  //! Records dropped because the ring was full
+  uint64_t dropped() const { return dropped_.load( std::memory_order_relaxed ); }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  //! The ring that Log writes to
+  static LogRing& global();
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence {};
+    LogLevel level {};
+    uint8_t length {};
+    std::array<char, MAX_MESSAGE> text {};
+  };
+
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas( 64 ) std::atomic<size_t> enqueue_position_ { 0 };
+  alignas( 64 ) std::atomic<size_t> dequeue_position_ { 0 };
+  std::atomic<uint64_t> dropped_ { 0 };
+};
+
+//! \brief Compile-time filtered logging into LogRing::global().
+//! \details A message below COMPILED_LOG_LEVEL compiles to nothing: its arguments are taken by reference
+//! and only formatted if the level is enabled, so `Log::trace( "routing ", dgram.header )` costs nothing
+//! in a build without tracing. Arguments may be strings, numbers, or anything with a to_string() member.
+//! Arguments that are costly to compute themselves belong inside `if constexpr ( Log::enabled( level ) )`.
+//! Router::route() and TCPStackDriver's timer drain the ring with Log::flush(); a program with another main
+//! loop should call it there.
+class Log
+{
+public:
+  static constexpr bool enabled( LogLevel level ) { return level >= COMPILED_LOG_LEVEL and level != LogLevel::Off; }
+
+  template<class... Args>
+  static void trace( const Args&... args )
+  {
+    write<LogLevel::Trace>( args... );
+  }
+
+  template<class... Args>
+  static void debug( const Args&... args )
+  {
+    write<LogLevel::Debug>( args... );
+  }
+
+  template<class... Args>
+  static void info( const Args&... args )
+  {
+    write<LogLevel::Info>( args... );
+  }
+
+  template<class... Args>
+  static void warn( const Args&... args )
+  {
+    write<LogLevel::Warn>( args... );
+  }
+
+  template<class... Args>
+  static void error( const Args&... args )
+  {
+    write<LogLevel::Error>( args... );
+  }
+
+  //! Drain the global ring to stderr, one line per record
+  static void flush();
+
+private:
+  template<LogLevel level, class... Args>
+  static void write( const Args&... args )
+  {
+    if constexpr ( enabled( level ) ) {
+      std::string message;
+      ( append( message, args ), ... );
+      LogRing::global().push( level, message );
+    }
+  }
+
+  template<class T>
+  static void append( std::string& message, const T& arg )
+  {
+    if constexpr ( std::is_convertible_v<const T&, std::string_view> ) {
+      message.append( std::string_view( arg ) );
+    } else if constexpr ( std::is_same_v<T, char> ) {
+      message.push_back( arg );
+    } else if constexpr ( std::is_arithmetic_v<T> ) {
+      message.append( std::to_string( arg ) );
+    } else if constexpr ( requires { { arg.to_string() } -> std::convertible_to<std::string>; } ) {
+      message.append( arg.to_string() );
+    } else {
+      static_assert( sizeof( T ) == 0, "Log: don't know how to format this argument" );
+    }
+  }
+};
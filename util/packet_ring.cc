@@ -0,0 +1,193 @@
+#include "packet_ring.hh"
+#include "exception.hh"
+
+#include <atomic>
+#include <cstring>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+namespace {
+
+// The status words are shared with the kernel: read them with acquire and write them with release
+// ordering, so the frame contents are seen (and published) before the status changes.
+uint32_t load_status( uint32_t& status )
+{
+  return atomic_ref<uint32_t>( status ).load( memory_order_acquire );
+}
+
+void store_status( uint32_t& status, uint32_t value )
+{
+  atomic_ref<uint32_t>( status ).store( value, memory_order_release );
+}
+
+string_view as_bytes( const auto& value )
+{
+  return { reinterpret_cast<const char*>( &value ), sizeof( value ) }; // NOLINT(*-reinterpret-cast)
+}
+
+// where a TX frame's data starts within its slot (see tpacket_parse_header() in the kernel)
+constexpr size_t TX_DATA_OFFSET = TPACKET_ALIGN( sizeof( tpacket3_hdr ) );
+
+} // namespace
+
+//! \param[in] interface is the name of the interface to bind to (e.g. "eth0")
+//! \param[in] ethertype selects the frames to receive, in host byte order
+//! \param[in] config sizes the rings
+PacketRing::PacketRing( const string& interface, uint16_t ethertype, const Config& config )
+  : PacketSocket( SOCK_RAW, htons( ethertype ) ), config_( config )
+{
+  const int version = TPACKET_V3;
+  setsockopt( SOL_PACKET, PACKET_VERSION, as_bytes( version ) );
+
+  tpacket_req3 rx {};
+  rx.tp_block_size = config_.block_size;
+  rx.tp_block_nr = config_.rx_block_count;
+  rx.tp_frame_size = TPACKET_ALIGNMENT << 7; // only used by the kernel's sanity checks for V3 RX
+  rx.tp_frame_nr = rx.tp_block_size / rx.tp_frame_size * rx.tp_block_nr;
+  rx.tp_retire_blk_tov = config_.retire_timeout_ms;
+  rx.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+  setsockopt( SOL_PACKET, PACKET_RX_RING, as_bytes( rx ) );
+
+  tpacket_req3 tx {};
+  tx.tp_block_size = config_.block_size;
+  tx.tp_block_nr = config_.tx_block_count;
+  tx.tp_frame_size = config_.tx_frame_size;
+  tx.tp_frame_nr = tx.tp_block_size / tx.tp_frame_size * tx.tp_block_nr;
+  setsockopt( SOL_PACKET, PACKET_TX_RING, as_bytes( tx ) );
+  tx_frame_count_ = tx.tp_frame_nr;
+
+  // one mapping: the RX ring, followed by the TX ring
+  const size_t ring_size = config_.block_size * ( config_.rx_block_count + config_.tx_block_count );
+  void* ring = mmap( nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd_num(), 0 );
+  if ( ring == MAP_FAILED ) {
+    // MAP_LOCKED can fail under RLIMIT_MEMLOCK; the ring still works without it
+    ring = mmap( nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_num(), 0 );
+  }
+  if ( ring == MAP_FAILED ) {
+    throw unix_error( "mmap" );
+  }
+  ring_ = unique_ptr<char, Unmap>( static_cast<char*>( ring ), Unmap { ring_size } );
+
+  sockaddr_ll address {};
+  address.sll_family = AF_PACKET;
+  address.sll_protocol = htons( ethertype );
+  address.sll_ifindex = static_cast<int>( if_nametoindex( interface.c_str() ) );
+  if ( address.sll_ifindex == 0 ) {
+    throw unix_error( "if_nametoindex(" + interface + ")" );
+  }
+  bind( { reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) } ); // NOLINT(*-reinterpret-cast)
+}
+
+void PacketRing::Unmap::operator()( char* ring ) const
+{
+  munmap( ring, size );
+}
+
+size_t PacketRing::recv( const function<void( const EthernetFrameView& )>& on_frame )
+{
+  size_t frames = 0;
+  for ( ;; ) {
+    auto* block = reinterpret_cast<tpacket_block_desc*>( rx_block( rx_block_ ) ); // NOLINT(*-reinterpret-cast)
+    if ( not( load_status( block->hdr.bh1.block_status ) & TP_STATUS_USER ) ) {
+      break;
+    }
+
+    const char* position = rx_block( rx_block_ ) + block->hdr.bh1.offset_to_first_pkt;
+    for ( uint32_t i = 0; i < block->hdr.bh1.num_pkts; i++ ) {
+      const auto* header = reinterpret_cast<const tpacket3_hdr*>( position ); // NOLINT(*-reinterpret-cast)
+      const string_view frame { position + header->tp_mac, header->tp_snaplen };
+      if ( frame.size() >= EthernetHeader::LENGTH ) {
+        // parse the header in place (network byte order)
+        EthernetFrameView view;
+        memcpy( view.header.dst.data(), frame.data(), view.header.dst.size() );
+        memcpy( view.header.src.data(), frame.data() + 6, view.header.src.size() );
+        view.header.type = static_cast<uint16_t>( static_cast<uint8_t>( frame[12] ) << 8 )
+                           | static_cast<uint8_t>( frame[13] );
+        view.payload = frame.substr( EthernetHeader::LENGTH );
+        on_frame( view );
+        frames++;
+      }
+      position += header->tp_next_offset;
+    }
+
+    register_read();
+    store_status( block->hdr.bh1.block_status, TP_STATUS_KERNEL );
+    rx_block_ = ( rx_block_ + 1 ) % config_.rx_block_count;
+  }
+  return frames;
+}
+
+size_t PacketRing::recv_frames( vector<EthernetFrame>& out )
+{
+  return recv( [&out]( const EthernetFrameView& view ) {
+    out.push_back( { view.header, { Buffer { string( view.payload ) } } } );
+  } );
+}
+
+char* PacketRing::tx_slot( size_t index ) const
+{
+  const size_t frames_per_block = config_.block_size / config_.tx_frame_size;
+  return ring_.get() + config_.block_size * ( config_.rx_block_count + index / frames_per_block )
+         + config_.tx_frame_size * ( index % frames_per_block );
+}
+
+bool PacketRing::queue( const vector<Buffer>& wire )
+{
+  auto* header = reinterpret_cast<tpacket3_hdr*>( tx_slot( tx_frame_ ) ); // NOLINT(*-reinterpret-cast)
+  size_t length = 0;
+  for ( const auto& buffer : wire ) {
+    length += buffer.size();
+  }
+  const uint32_t status = load_status( header->tp_status );
+  if ( ( status != TP_STATUS_AVAILABLE and status != TP_STATUS_WRONG_FORMAT )
+       or TX_DATA_OFFSET + length > config_.tx_frame_size ) {
+    tx_dropped_++;
+    return false;
+  }
+
+  char* data = tx_slot( tx_frame_ ) + TX_DATA_OFFSET;
+  for ( const auto& buffer : wire ) {
+    const string_view bytes = buffer;
+    memcpy( data, bytes.data(), bytes.size() );
+    data += bytes.size();
+  }
+  header->tp_len = length;
+  header->tp_snaplen = length;
+  header->tp_next_offset = 0;
+  store_status( header->tp_status, TP_STATUS_SEND_REQUEST );
+
+  tx_frame_ = ( tx_frame_ + 1 ) % tx_frame_count_;
+  tx_pending_ = true;
+  return true;
+}
+
+size_t PacketRing::send_frames( const vector<vector<Buffer>>& frames )
+{
+  size_t queued = 0;
+  for ( const auto& frame : frames ) {
+    queued += queue( frame );
+  }
+  flush();
+  return queued;
+}
+
+void PacketRing::flush()
+{
+  if ( not tx_pending_ ) {
+    return;
+  }
+  // one system call transmits every slot marked TP_STATUS_SEND_REQUEST
+  if ( ::sendto( fd_num(), nullptr, 0, MSG_DONTWAIT, nullptr, 0 ) < 0 ) {
+    if ( errno == EAGAIN or errno == ENOBUFS ) {
+      return; // the device queue is full; the slots stay marked and go out with the next flush()
+    }
+    throw unix_error( "sendto" );
+  }
+  register_write();
+  tx_pending_ = false;
+}
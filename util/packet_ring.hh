@@ -0,0 +1,88 @@
+#pragma once
+
+#include "buffer.hh"
+#include "ethernet_frame.hh"
+#include "socket.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! An Ethernet frame still sitting in a PacketRing's receive ring (valid only during the callback)
+struct EthernetFrameView
+{
+  EthernetHeader header {};
+  std::string_view payload {};
+};
+
+//! \brief A [packet socket](\ref man7::packet) bound to one interface, with memory-mapped
+//! [TPACKET_V3](https://www.kernel.org/doc/Documentation/networking/packet_mmap.txt) rings in both directions.
+//! \details The kernel writes received frames straight into the RX ring, a block of frames at a time, and
+//! recv() walks them in place, so receiving takes no system call per frame. Outgoing frames are
+//! copied into slots of the TX ring with queue(), and flush() hands all of them to the kernel with
+//! a single sendto(). Like any packet socket, this needs CAP_NET_RAW.
+class PacketRing : public PacketSocket
+{
+public:
+  struct Config
+  {
+    size_t block_size = 1 << 18;    //!< bytes per ring block (a multiple of the page size)
+    size_t rx_block_count = 16;     //!< RX ring blocks
+    size_t tx_block_count = 4;      //!< TX ring blocks
+    size_t tx_frame_size = 2048;    //!< bytes per TX slot, including the slot header
+    uint32_t retire_timeout_ms = 2; //!< hand a partly filled RX block to user space after this long
+  };
+
+  //! Bind to `interface`, receiving frames of `ethertype` (ETH_P_ALL for every frame)
+  explicit PacketRing( const std::string& interface, uint16_t ethertype, const Config& config );
+  explicit PacketRing( const std::string& interface, uint16_t ethertype ) : PacketRing( interface, ethertype, {} )
+  {}
+
+  //! Call `on_frame` for each frame waiting in the RX ring, then return the blocks to the kernel.
+  //! Returns the number of frames.
+  size_t recv( const std::function<void( const EthernetFrameView& )>& on_frame );
+
+  //! Append the waiting frames to `out` (each payload is copied out of the ring into one Buffer)
+  size_t recv_frames( std::vector<EthernetFrame>& out );
+
+  //! Copy a frame in wire format (e.g. from NetworkInterface::drain_frames) into the next TX slot.
+  //! Returns false if the ring is full or the frame doesn't fit in a slot.
+  bool queue( const std::vector<Buffer>& wire );
+
+  //! Queue each frame and flush; returns the number of frames queued
+  size_t send_frames( const std::vector<std::vector<Buffer>>& frames );
+
+  //! Ask the kernel to transmit every queued frame
+  void flush();
+
+  //! Frames that didn't fit in the TX ring
+  uint64_t tx_dropped() const { return tx_dropped_; }
+
+  PacketRing( const PacketRing& other ) = delete;
+  PacketRing& operator=( const PacketRing& other ) = delete;
+  PacketRing( PacketRing&& other ) = delete;
+  PacketRing& operator=( PacketRing&& other ) = delete;
+
+private:
+  // Unmaps the ring, also when the constructor throws after mapping it
+  struct Unmap
+  {
+    size_t size;
+    void operator()( char* ring ) const;
+  };
+
+  Config config_;
+  std::unique_ptr<char, Unmap> ring_ {};
+  size_t rx_block_ {}; // next RX block to look at
+  size_t tx_frame_ {}; // next TX slot to fill
+  size_t tx_frame_count_ {};
+  bool tx_pending_ {};
+  uint64_t tx_dropped_ {};
+
+  char* rx_block( size_t index ) const { return ring_.get() + index * config_.block_size; }
+  char* tx_slot( size_t index ) const;
+};
@@ -14,9 +14,32 @@ public:
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr uint8_t MAX_WINDOW_SCALE = 14;  //!< Largest window scale shift allowed by RFC 7323
+  static constexpr size_t PACING_BURST = 2 * MAX_PAYLOAD_SIZE; //!< Token-bucket depth of the pacer, in bytes
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
   std::optional<Wrap32> fixed_isn {};
+
+  bool pacing = false;       //!< Release outgoing segments through a token-bucket pacer
+  uint64_t pacing_rate = 0;  //!< Pacing rate in bytes/s (0 means derive it from the window and smoothed RTT)
+  bool bbr = false;          //!< Use BBR-style model-based congestion control (always paces)
+  bool rack_tlp = false;     //!< Tail loss probes and RACK-style time-based loss detection
+  bool persist_timer = false; //!< Probe a zero window with a backed-off persist timer instead of sending data
+  std::optional<uint8_t> window_scale {}; //!< Window scale shift to offer on SYN (unset: no window scaling)
+  uint64_t delayed_ack_ms = 0; //!< Hold back ACKs for in-order data up to this long (0: ACK every segment)
+  size_t recv_capacity_max = 0; //!< Auto-tune the receive buffer between recv_capacity and this (0: fixed)
+  bool sws_avoidance = false; //!< Receiver opens its window in steps of min(MSS, capacity/2) (RFC 1122)
+  bool nagle = false;         //!< Sender holds back small segments while data is unacknowledged (RFC 896)
+
+  //! Smallest window scale shift that lets a receiver advertise all of `capacity`
+  static constexpr uint8_t window_scale_for( size_t capacity )
+  {
+    uint8_t shift = 0;
+    while ( shift < MAX_WINDOW_SCALE && ( capacity >> shift ) > UINT16_MAX ) {
+      shift++;
+    }
+    return shift;
+  }
 };
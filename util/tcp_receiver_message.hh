@@ -15,6 +15,8 @@
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
  *    the <cstdint> header).
+ *    If window scaling was negotiated on the SYNs, the window is this value shifted left by the
+ *    receiver's window scale (so the receiver can offer more than 64 KiB).
  */
 
 struct TCPReceiverMessage
@@ -0,0 +1,200 @@
+#include "tcp_segment.hh"
+#include "checksum.hh"
+
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr uint16_t FLAG_FIN = 0x01;
+constexpr uint16_t FLAG_SYN = 0x02;
+constexpr uint16_t FLAG_RST = 0x04;
+constexpr uint16_t FLAG_PSH = 0x08;
+constexpr uint16_t FLAG_ACK = 0x10;
+constexpr size_t MSS_OPTION_LENGTH = 4;
+constexpr size_t WINDOW_SCALE_OPTION_LENGTH = 3;
+} // namespace
+
+size_t TCPSegment::header_length() const
+{
+  size_t options = 0;
+  if ( mss.has_value() ) {
+    options += MSS_OPTION_LENGTH;
+  }
+  if ( sender_message.window_scale.has_value() ) {
+    options += WINDOW_SCALE_OPTION_LENGTH;
+  }
+  // options are padded to a multiple of 32 bits
+  return LENGTH + ( options + 3 ) / 4 * 4;
+}
+
+void TCPSegment::serialize_header( Serializer& serializer, uint16_t checksum ) const
+{
+  serializer.integer( sport );
+  serializer.integer( dport );
+  serializer.integer( sender_message.seqno.raw_value() );
+  serializer.integer( receiver_message.ackno.value_or( Wrap32 { 0 } ).raw_value() );
+
+  const uint16_t flags = ( sender_message.FIN ? FLAG_FIN : 0U ) | ( sender_message.SYN ? FLAG_SYN : 0U )
+                         | ( RST ? FLAG_RST : 0U ) | ( PSH ? FLAG_PSH : 0U )
+                         | ( receiver_message.ackno.has_value() ? FLAG_ACK : 0U );
+  const uint16_t offset_and_flags = static_cast<uint16_t>( header_length() / 4 << 12 ) | flags;
+  serializer.integer( offset_and_flags );
+  serializer.integer( receiver_message.window_size );
+  serializer.integer( checksum );
+  serializer.integer( uint16_t { 0 } ); // urgent pointer
+
+  size_t options = 0;
+  if ( mss.has_value() ) {
+    serializer.integer( OPTION_MSS );
+    serializer.integer( static_cast<uint8_t>( MSS_OPTION_LENGTH ) );
+    serializer.integer( mss.value() );
+    options += MSS_OPTION_LENGTH;
+  }
+  if ( sender_message.window_scale.has_value() ) {
+    serializer.integer( OPTION_NOP );
+    serializer.integer( OPTION_WINDOW_SCALE );
+    serializer.integer( static_cast<uint8_t>( WINDOW_SCALE_OPTION_LENGTH ) );
+    serializer.integer( sender_message.window_scale.value() );
+    options += WINDOW_SCALE_OPTION_LENGTH + 1;
+  }
+  for ( ; options % 4; options++ ) {
+    serializer.integer( OPTION_END );
+  }
+}
+
+void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer, cksum );
+  serializer.buffer( sender_message.payload );
+}
+
+void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
+{
+  Serializer header;
+  serialize_header( header, 0 );
+
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  check.add( header.output() );
+  check.add( sender_message.payload );
+  cksum = check.value();
+}
+
+void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+{
+  uint32_t seqno {};
+  uint32_t ackno {};
+  uint16_t offset_and_flags {};
+  uint16_t urgent {};
+
+  parser.integer( sport );
+  parser.integer( dport );
+  parser.integer( seqno );
+  parser.integer( ackno );
+  parser.integer( offset_and_flags );
+  parser.integer( receiver_message.window_size );
+  parser.integer( cksum );
+  parser.integer( urgent );
+  if ( parser.has_error() ) {
+    return;
+  }
+
+  const size_t data_offset = static_cast<size_t>( offset_and_flags >> 12 ) * 4;
+  if ( data_offset < LENGTH ) {
+    parser.set_error();
+    return;
+  }
+
+  sender_message.seqno = Wrap32 { seqno };
+  sender_message.SYN = offset_and_flags & FLAG_SYN;
+  sender_message.FIN = offset_and_flags & FLAG_FIN;
+  RST = offset_and_flags & FLAG_RST;
+  PSH = offset_and_flags & FLAG_PSH;
+  receiver_message.ackno.reset();
+  if ( offset_and_flags & FLAG_ACK ) {
+    receiver_message.ackno = Wrap32 { ackno };
+  }
+
+  // The options are kept as raw bytes for the checksum; MSS and window scale are decoded.
+  string options( data_offset - LENGTH, 0 );
+  parser.string( options );
+  if ( parser.has_error() ) {
+    return;
+  }
+  mss.reset();
+  sender_message.window_scale.reset();
+  for ( size_t i = 0; i < options.size(); ) {
+    const auto kind = static_cast<uint8_t>( options[i] );
+    if ( kind == OPTION_END ) {
+      break;
+    }
+    if ( kind == OPTION_NOP ) {
+      i++;
+      continue;
+    }
+    if ( i + 1 >= options.size() ) {
+      parser.set_error();
+      return;
+    }
+    const auto length = static_cast<uint8_t>( options[i + 1] );
+    if ( length < 2 or i + length > options.size() ) {
+      parser.set_error();
+      return;
+    }
+    if ( kind == OPTION_MSS and length == MSS_OPTION_LENGTH ) {
+      const auto high = static_cast<uint8_t>( options[i + 2] );
+      const auto low = static_cast<uint8_t>( options[i + 3] );
+      mss = static_cast<uint16_t>( high << 8 | low );
+    } else if ( kind == OPTION_WINDOW_SCALE and length == WINDOW_SCALE_OPTION_LENGTH ) {
+      sender_message.window_scale = static_cast<uint8_t>( options[i + 2] );
+    }
+    i += length;
+  }
+
+  vector<Buffer> payload;
+  parser.all_remaining( payload );
+
+  // Verify the checksum over the header as received and the payload pieces, without joining them
+  Serializer fixed;
+  fixed.integer( sport );
+  fixed.integer( dport );
+  fixed.integer( seqno );
+  fixed.integer( ackno );
+  fixed.integer( offset_and_flags );
+  fixed.integer( receiver_message.window_size );
+  fixed.integer( cksum );
+  fixed.integer( urgent );
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  check.add( fixed.output() );
+  check.add( options );
+  check.add( payload );
+  if ( check.value() != 0 ) {
+    parser.set_error();
+  }
+
+  if ( payload.size() == 1 ) {
+    sender_message.payload = move( payload.front() );
+  } else {
+    string joined;
+    for ( const auto& piece : payload ) {
+      joined.append( string_view { piece } );
+    }
+    sender_message.payload = move( joined );
+  }
+}
+
+string TCPSegment::to_string() const
+{
+  stringstream ss {};
+  ss << "TCP " << sport << "->" << dport << " seqno=" << sender_message.seqno.raw_value();
+  if ( receiver_message.ackno.has_value() ) {
+    ss << " ackno=" << receiver_message.ackno->raw_value();
+  }
+  ss << " win=" << receiver_message.window_size;
+  ss << ( sender_message.SYN ? " +SYN" : "" ) << ( sender_message.FIN ? " +FIN" : "" ) << ( RST ? " +RST" : "" );
+  if ( not sender_message.payload.empty() ) {
+    ss << " payload_len=" << sender_message.payload.size();
+  }
+  return ss.str();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "parser.hh"
+#include "tcp_receiver_message.hh"
+#include "tcp_sender_message.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// TCP segment: a TCPSenderMessage and a TCPReceiverMessage, as they are carried in a real TCP header
+struct TCPSegment
+{
+  static constexpr size_t LENGTH = 20;            // TCP header length, not including options
+  static constexpr uint8_t OPTION_END = 0;        // End of option list
+  static constexpr uint8_t OPTION_NOP = 1;        // No-operation (padding)
+  static constexpr uint8_t OPTION_MSS = 2;        // Maximum segment size (SYN only)
+  static constexpr uint8_t OPTION_WINDOW_SCALE = 3; // Window scale shift (SYN only, RFC 7323)
+
+  /*
+   *   0                   1                   2                   3
+   *   0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |          Source Port          |       Destination Port        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                        Sequence Number                        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                    Acknowledgment Number                      |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |  Data |       |C|E|U|A|P|R|S|F|                               |
+   *  | Offset| Rsrvd |W|C|R|C|S|S|Y|I|            Window             |
+   *  |       |       |R|E|G|K|H|T|N|N|                               |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |           Checksum            |         Urgent Pointer        |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                    Options                    |    Padding    |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *  |                             data                              |
+   *  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   *
+   * The sequence number, SYN, FIN, payload and window scale option come from the sender_message;
+   * the acknowledgment number (and ACK flag) and window come from the receiver_message.
+   */
+
+  uint16_t sport = 0;                   // source port
+  uint16_t dport = 0;                   // destination port
+  TCPSenderMessage sender_message {};   // seqno, SYN, payload, FIN, window scale option
+  TCPReceiverMessage receiver_message {}; // ackno (ACK flag set iff present), window
+  bool RST = false;                     // reset flag
+  bool PSH = false;                     // push flag
+  std::optional<uint16_t> mss {};       // MSS option (only sent on SYN)
+  uint16_t cksum = 0;                   // checksum field
+
+  // Header length (including options) in bytes
+  size_t header_length() const;
+
+  /*
+   * Set the checksum to the correct value. `datagram_layer_pseudo_checksum` is the pseudo-header's
+   * contribution (IPv4Header::pseudo_checksum() of a header whose length already covers this segment).
+   * The payload is summed in place, never copied.
+   */
+  void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Return a string containing the segment in human-readable format
+  std::string to_string() const;
+
+  // Parse and verify the checksum (the parser is put in the error state if it doesn't match)
+  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+
+  // Serialize the segment (does not recompute the checksum); the payload is appended without copying
+  void serialize( Serializer& serializer ) const;
+
+private:
+  void serialize_header( Serializer& serializer, uint16_t checksum ) const;
+};
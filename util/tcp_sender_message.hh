@@ -3,12 +3,14 @@
 #include "buffer.hh"
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains four fields:
+ * It contains five fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -19,6 +21,10 @@
  * 3) The payload: a substring (possibly empty) of the byte stream.
  *
  * 4) The FIN flag. If set, it means the payload represents the ending of the byte stream.
+ *
+ * 5) The window scale option (RFC 7323), only ever present on a SYN. It is the shift that the
+ *    *sending* side's receiver will apply to the windows it advertises, if the other side also
+ *    offers the option. Scaling is used in both directions only when both SYNs carry it.
  */
 
 struct TCPSenderMessage
@@ -27,6 +33,7 @@ struct TCPSenderMessage
   bool SYN { false };
   Buffer payload {};
   bool FIN { false };
+  std::optional<uint8_t> window_scale {};
 
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }